@@ -53,27 +53,45 @@ CONFIG(release, debug|release) {
 SOURCES = src/main.cpp \
           src/dither.cpp \
           src/kobodevicedescriptor.cpp \
+          src/kobofbcursor.cpp \
           src/kobofbscreen.cpp \
+          src/koboinputthread.cpp \
+          src/kobokeyhandler.cpp \
+          src/kobolatencytracker.cpp \
+          src/koboredrawstats.cpp \
+          src/koborefresharbiter.cpp \
+          src/kobostartuptrace.cpp \
+          src/kobovirtualepdc.cpp \
           src/koboplatformintegration.cpp \
           src/qevdevtouchdata.cpp \
           src/qevdevtouchdata2.cpp \
-          src/qevdevtouchhandlerthread.cpp \
+          src/qevdevtouchhandlerproxy.cpp \
           src/qevdevtouchmanager.cpp \
-          src/qevdevtouchhandler.cpp
+          src/qevdevtouchhandler.cpp \
+          src/qevdevtouchrecorder.cpp
 
 HEADERS = \
           src/dither.h \
           src/einkenums.h \
           src/kobodevicedescriptor.h \
+          src/kobofbcursor.h \
           src/kobofbscreen.h \
+          src/koboinputthread.h \
+          src/kobokeyhandler.h \
+          src/kobolatencytracker.h \
+          src/koboredrawstats.h \
+          src/koborefresharbiter.h \
+          src/kobostartuptrace.h \
+          src/kobovirtualepdc.h \
           src/koboplatformfunctions.h \
           src/koboplatformintegration.h \
           src/qevdevtouchdata.h \
           src/qevdevtouchdata2.h \
           src/qevdevtouchfilter_p.h \
           src/qevdevtouchhandler.h \
-          src/qevdevtouchhandlerthread.h \
-          src/qevdevtouchmanager_p.h
+          src/qevdevtouchhandlerproxy.h \
+          src/qevdevtouchmanager_p.h \
+          src/qevdevtouchrecorder.h
 
 
 OTHER_FILES += \
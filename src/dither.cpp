@@ -246,7 +246,7 @@ void ditherFloydSteinberg(uint8_t* dest, uint8_t* src, int width, int height)
             if (x + 1 < width)
                 errorB[i + 1] += (quantError * f7_16);
 
-            if (x - 1 > 0 && y + 1 < height)
+            if (x > 0 && y + 1 < height)
                 errorB[i + width - 1] += (quantError * f3_16);
 
             if (y + 1 < height)
@@ -299,8 +299,10 @@ void ditherFloydSteinbergN(uint8_t* dest, uint8_t* src, int width, int height)
                 int16_t quantError = errorLine[x];
                 // errorB[i + x - 1] += (quantError * f3_16);
                 errorB[i + x + 0] += (quantError * f5_16);
-                errorB[i + x + 1] += (quantError * f1_16);
+                if (x + 1 < width)
+                    errorB[i + x + 1] += (quantError * f1_16);
             }
+#ifdef __ARM_NEON__
             for (x = 1; x + 7 < width - 1; x += 8)
             {
                 int16x8_t quantErrorv = vld1q_s16(&errorLine[x]);
@@ -320,6 +322,9 @@ void ditherFloydSteinbergN(uint8_t* dest, uint8_t* src, int width, int height)
                 int16x8_t resAddv3 = vaddq_s16(resErrorv3, multv3);
                 vst1q_s16(&errorB[i + x + 1], resAddv3);
             }
+#else
+            x = 1;
+#endif
             for (; x < width; x++)
             {
                 int16_t quantError = errorLine[x];
@@ -10,6 +10,12 @@
 #include <arm_neon.h>
 #endif
 
+// The kernels ditherBuffer picks from, dither_fallback is the reference the others have to match
+void dither_fallback(uint8_t* bufferDst, uint8_t* bufferSrc, int width, int height);
+#ifdef __ARM_NEON__
+void dither_NEON(uint8_t* bufferDest, uint8_t* bufferSrc, int width, int height);
+#endif
+
 void ditherBuffer(uint8_t* bufferDest, uint8_t* bufferSrc, int width, int height);
 void ditherBufferInplace(uint8_t* buffer, int width, int height);
 
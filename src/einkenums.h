@@ -81,4 +81,42 @@ enum WaveForm
     // not pure image content.
 };
 
+// QWindow dynamic property with the waveform for everything the window repaints: a WaveForm value,
+// or one of "ui" (DU), "image" (GC16), "text" (REAGL where available, GL16 otherwise) or a waveform name
+static const char *const KoboWaveformHintProperty = "kobo_waveform";
+
+enum RefreshFlag
+{
+    RefreshFlag_None = 0,
+    RefreshFlag_Flashing = 0x1,
+    // Ordered dithering by the EPDC, ignored on devices without it
+    RefreshFlag_HardwareDithering = 0x2
+};
+
+// What submitRefresh returns instead of an FBInk update marker
+enum RefreshMarker : quint32
+{
+    RefreshMarker_Failed = 0,             // Nothing reached the panel, never completes
+    RefreshMarker_Deferred = 0xffffffff   // Held back by sunxi pen mode, completes with the cleanup refresh
+};
+
+enum ScreenBuffer
+{
+    ScreenBuffer_Composed = 0,     // What Qt composed from the windows
+    ScreenBuffer_Dithered = 1,     // The same after software dithering, null when it is off
+    ScreenBuffer_Framebuffer = 2   // The mmap'd framebuffer, with the cursor and fast ink in it
+};
+
+// Stages from a finger touching the screen until the resulting repaint is on the panel, see touchlatency
+enum LatencyStage
+{
+    LatencyStage_Input = 0,          // kernel timestamp of the SYN_REPORT until the touch goes to Qt
+    LatencyStage_Application = 1,    // until the application's repaint reaches the screen
+    LatencyStage_Render = 2,         // compose, dither, blit and coalescing until the refresh ioctl
+    LatencyStage_Display = 3,        // until the EPDC reports the update complete
+    LatencyStage_TouchToSubmit = 4,  // the first three together
+    LatencyStage_TouchToPhoton = 5,  // all of them
+    LatencyStage_Count = 6
+};
+
 #endif  // EINKENUMS_H
@@ -6,6 +6,10 @@
 #include <sys/ioctl.h>
 #include <unistd.h>
 
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QSaveFile>
+
 // Kobo Touch A/B:
 KoboDeviceDescriptor KoboTrilogyAB = {
     .device = KoboTouchAB,
@@ -192,6 +196,15 @@ KoboDeviceDescriptor KoboGoldfinch = {
     .dpi = 300,
 };
 
+// Kobo Elipsa 2E
+KoboDeviceDescriptor KoboCondor = {
+    .device = KoboElipsa2E,
+    .mark = 8,
+    .dpi = 227,
+    .hasGSensor = true,
+    .touchscreenSettings= {.invertX = false, .invertY = true},
+};
+
 // Kobo Libra Colour
 KoboDeviceDescriptor KoboMonza = {
     .device = KoboLibraColour,
@@ -217,6 +230,23 @@ KoboDeviceDescriptor KoboSpaColour = {
     .isColor = true,
     };
 
+// Product id from the version file to the codename kobo_config.sh would print. Tolinos running the
+// Kobo firmware report the id of the Kobo they are based on plus 300
+static const QMap<int, QString> KoboCodenames = {
+    {310, "trilogy"},  {320, "trilogy"}, {330, "kraken"},    {340, "pixie"},  {350, "dragon"},
+    {360, "phoenix"},  {370, "dahlia"},  {371, "alyssum"},   {372, "pika"},   {373, "daylight"},
+    {374, "snow"},     {375, "star"},    {376, "nova"},      {377, "frost"},  {378, "snow"},
+    {379, "star"},     {380, "frost"},   {381, "daylight"},  {382, "luna"},   {383, "cadmus"},
+    {384, "storm"},    {386, "goldfinch"}, {387, "europa"},  {388, "io"},     {389, "condor"},
+    {390, "monza"},    {391, "spaBW"},   {393, "spaColour"},
+    {690, "monzaTolino"}, {691, "spaTolinoBW"}, {693, "spaTolinoColour"},
+};
+
+static const char *versionFile = "/mnt/onboard/.kobo/version";
+static const char *cacheFile = "/dev/shm/qt-kobo-device";
+static const quint32 cacheMagic = 0x4b444556;
+static const quint32 cacheVersion = 1;
+
 static QString exec(const char *cmd)
 {
     std::array<char, 128> buffer;
@@ -224,7 +254,8 @@ static QString exec(const char *cmd)
     std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd, "r"), pclose);
     if (!pipe)
     {
-        throw std::runtime_error("popen() failed!");
+        qDebug() << "Failed to run" << cmd;
+        return result;
     }
     while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr)
     {
@@ -233,6 +264,85 @@ static QString exec(const char *cmd)
     return result.trimmed();
 }
 
+static QByteArray readFirstLine(const char *path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readLine().trimmed();
+}
+
+// The sixth field of the version file, e.g. 00000000-0000-0000-0000-000000000376
+static int readModelNumber()
+{
+    const QList<QByteArray> fields = readFirstLine(versionFile).split(',');
+    if (fields.size() < 6)
+        return 0;
+
+    QByteArray id = fields.at(5);
+    int i = 0;
+    while (i < id.size() && (id.at(i) == '0' || id.at(i) == '-'))
+        ++i;
+    return id.mid(i).toInt();
+}
+
+struct DeviceIdentity
+{
+    QString codename;
+    int modelNumber = 0;
+    qint64 detectionUs = 0;  // what the detection cost when the cache was written
+    bool fromProductId = false;  // only these are cached, the fallbacks are asked again next time
+};
+
+// Valid until the next boot, the version file can change with a firmware update which always reboots
+static bool loadCachedIdentity(const QByteArray &bootId, DeviceIdentity &identity)
+{
+    QFile file(cacheFile);
+    if (bootId.isEmpty() || !file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    quint32 magic = 0, version = 0;
+    QByteArray cachedBootId;
+    stream >> magic >> version >> cachedBootId;
+    if (magic != cacheMagic || version != cacheVersion || cachedBootId != bootId)
+        return false;
+
+    qint32 modelNumber = 0;
+    stream >> identity.codename >> modelNumber >> identity.detectionUs;
+    identity.modelNumber = modelNumber;
+    return stream.status() == QDataStream::Ok && !identity.codename.isEmpty();
+}
+
+static void storeCachedIdentity(const QByteArray &bootId, const DeviceIdentity &identity)
+{
+    // Written aside and renamed, so a concurrently starting application never reads half of it
+    QSaveFile file(cacheFile);
+    if (bootId.isEmpty() || !file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream stream(&file);
+    stream << cacheMagic << cacheVersion << bootId << identity.codename << qint32(identity.modelNumber)
+           << identity.detectionUs;
+    file.commit();
+}
+
+static DeviceIdentity detectIdentity()
+{
+    DeviceIdentity identity;
+    identity.modelNumber = readModelNumber();
+    identity.codename = KoboCodenames.value(identity.modelNumber);
+    identity.fromProductId = !identity.codename.isEmpty();
+
+    // Models newer than the table
+    if (identity.codename.isEmpty())
+        identity.codename = qEnvironmentVariable("DEVICE_CODENAME");
+    if (identity.codename.isEmpty() && QFile::exists("/bin/kobo_config.sh"))
+        identity.codename = exec("/bin/kobo_config.sh 2>/dev/null");
+
+    return identity;
+}
+
 static QRect determineGeometry(const fb_var_screeninfo &vinfo)
 {
     int xoff = vinfo.xoffset;
@@ -260,17 +370,39 @@ static QSizeF determinePhysicalSize(const fb_var_screeninfo &vinfo, const QSize
     return QSize(mmWidth, mmHeight);
 }
 
-KoboDeviceDescriptor determineDevice()
+KoboDeviceDescriptor determineDevice(bool debug, bool virtualDevice)
 {
-    QString deviceName;
-    if(QFile::exists("/bin/kobo_config.sh")) {
-        deviceName = exec("/bin/kobo_config.sh 2>/dev/null");
+    QElapsedTimer timer;
+    timer.start();
+
+    const QByteArray bootId = readFirstLine("/proc/sys/kernel/random/boot_id");
+    DeviceIdentity identity;
+    if (virtualDevice)
+    {
+        // Not cached, a workstation switches between profiles from one run to the next
+        identity.codename = qEnvironmentVariable("DEVICE_CODENAME", QStringLiteral("nova"));
+        if (debug)
+            qDebug() << "Virtual device with the profile of" << identity.codename;
     }
-    else {
-        deviceName = std::getenv("DEVICE_CODENAME");
+    else if (loadCachedIdentity(bootId, identity))
+    {
+        if (debug)
+            qDebug() << "Device" << identity.codename << identity.modelNumber << "from cache in"
+                     << timer.nsecsElapsed() / 1000 << "us, detection took" << identity.detectionUs << "us";
+    }
+    else
+    {
+        identity = detectIdentity();
+        identity.detectionUs = timer.nsecsElapsed() / 1000;
+        if (identity.fromProductId)
+            storeCachedIdentity(bootId, identity);
+        if (debug)
+            qDebug() << "Detected device" << identity.codename << identity.modelNumber << "in"
+                     << identity.detectionUs << "us";
     }
-    auto modelNumberStr = exec("cut -f 6 -d ',' /mnt/onboard/.kobo/version | sed -e 's/^[0-]*//'");
-    int modelNumber = modelNumberStr.toInt();
+
+    const QString deviceName = identity.codename;
+    const int modelNumber = identity.modelNumber;
 
     KoboDeviceDescriptor device;
     if (deviceName == "trilogy")
@@ -358,6 +490,10 @@ KoboDeviceDescriptor determineDevice()
     {
         device = KoboGoldfinch;
     }
+    else if (deviceName == "condor")
+    {
+        device = KoboCondor;
+    }
     else if (deviceName == "monza" || deviceName == "monzaTolino" )
     {
         device = KoboMonza;
@@ -375,6 +511,14 @@ KoboDeviceDescriptor determineDevice()
         device = KoboTrilogyC;
     }
 
+    device.modelName = deviceName;
+    device.modelNumber = modelNumber;
+    device.hasHardwareDithering = device.mark >= 7 || device.isSunxi;
+
+    // The size comes from the virtual framebuffer, set up by the screen
+    if (virtualDevice)
+        return device;
+
     QString fbDevice = QLatin1String("/dev/fb0");
     if (!QFile::exists(fbDevice))
         fbDevice = QLatin1String("/dev/graphics/fb0");
@@ -418,9 +562,6 @@ KoboDeviceDescriptor determineDevice()
     device.physicalWidth = mPhysicalSize.width();
     device.physicalHeight = mPhysicalSize.height();
 
-    device.modelName = deviceName;
-    device.modelNumber = modelNumber;
-
     close(mFbFd);
 
     return device;
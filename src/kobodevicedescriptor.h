@@ -31,7 +31,8 @@ enum KoboDevice
     KoboClara2E,
     KoboLibraColour,
     KoboClaraBW,
-    KoboClaraColour
+    KoboClaraColour,
+    KoboElipsa2E
 };
 
 struct TouchscreenSettings
@@ -72,8 +73,14 @@ struct KoboDeviceDescriptor
     bool isSunxi = false;
 
     bool isColor = false;
+
+    // The EPDC of mk7 and newer and the sunxi one can dither while refreshing, sparing the CPU the work
+    bool hasHardwareDithering = false;
 };
 
-KoboDeviceDescriptor determineDevice();
+// An identity found from the product id is cached in /dev/shm for the current boot, only the first launch
+// reads the version file.
+// A virtual device takes the profile named by DEVICE_CODENAME and doesn't look at the framebuffer.
+KoboDeviceDescriptor determineDevice(bool debug = false, bool virtualDevice = false);
 
 #endif  // KOBODEVICEDESCRIPTOR_H
@@ -0,0 +1,93 @@
+#include "kobofbcursor.h"
+
+#include <qpa/qplatformcursor.h>
+
+#include <QCursor>
+
+#include "kobofbscreen.h"
+
+KoboFbCursor::Sprite KoboFbCursor::makeSprite(const QImage &image, const QPoint &hotspot, QImage::Format format)
+{
+    const QImage argb = image.convertToFormat(QImage::Format_ARGB32).copy(
+        0, 0, qMin(image.width(), MaxSpriteSize), qMin(image.height(), MaxSpriteSize));
+
+    Sprite sprite;
+    sprite.hotspot = hotspot;
+    sprite.mask = QImage(argb.size(), QImage::Format_Mono);
+    sprite.mask.fill(0);
+
+    QImage thresholded(argb.size(), QImage::Format_RGB32);
+    for (int y = 0; y < argb.height(); y++)
+    {
+        const QRgb *line = reinterpret_cast<const QRgb *>(argb.constScanLine(y));
+        for (int x = 0; x < argb.width(); x++)
+        {
+            if (qAlpha(line[x]) >= 128)
+                sprite.mask.setPixel(x, y, 1);
+            thresholded.setPixel(x, y, qGray(line[x]) < 128 ? qRgb(0, 0, 0) : qRgb(255, 255, 255));
+        }
+    }
+    sprite.pixels = thresholded.convertToFormat(format);
+
+    return sprite;
+}
+
+KoboFbCursor::KoboFbCursor(KoboFbScreen *screen, bool screenRendered)
+    : QFbCursor(screen), mKoboScreen(screen), mScreenRendered(screenRendered)
+{
+}
+
+void KoboFbCursor::setDirty()
+{
+    if (!mScreenRendered)
+    {
+        QFbCursor::setDirty();
+        return;
+    }
+
+    // Called by pointerEvent() on every move, this is what drives cursor rendering
+    mKoboScreen->scheduleCursorUpdate();
+}
+
+bool KoboFbCursor::isDirty() const
+{
+    return mScreenRendered ? false : QFbCursor::isDirty();
+}
+
+QRect KoboFbCursor::drawCursor(QPainter &painter)
+{
+    if (mScreenRendered)
+        return QRect();
+
+    return QFbCursor::drawCursor(painter);
+}
+
+#ifndef QT_NO_CURSOR
+void KoboFbCursor::changeCursor(QCursor *widgetCursor, QWindow *window)
+{
+    QFbCursor::changeCursor(widgetCursor, window);
+
+    mShape = widgetCursor ? widgetCursor->shape() : Qt::ArrowCursor;
+    if (mShape == Qt::BitmapCursor)
+        mBitmapSprite = makeSprite(widgetCursor->pixmap().toImage(), widgetCursor->hotSpot(), mKoboScreen->format());
+
+    if (mScreenRendered)
+        mKoboScreen->cursorShapeChanged();
+}
+#endif
+
+const KoboFbCursor::Sprite &KoboFbCursor::sprite()
+{
+    if (mShape == Qt::BitmapCursor)
+        return mBitmapSprite;
+
+    // Every shape is only thresholded once
+    auto it = mSprites.find(mShape);
+    if (it == mSprites.end())
+    {
+        QPlatformCursorImage image(nullptr, nullptr, 0, 0, 0, 0);
+        image.set(mShape);
+        it = mSprites.insert(mShape, makeSprite(*image.image(), image.hotspot(), mKoboScreen->format()));
+    }
+    return it.value();
+}
@@ -0,0 +1,48 @@
+#ifndef KOBOFBCURSOR_H
+#define KOBOFBCURSOR_H
+
+#include <QtFbSupport/private/qfbcursor_p.h>
+
+#include <QHash>
+#include <QImage>
+
+class KoboFbScreen;
+
+// Forwards pointer motion to the screen so the cursor is only rendered when it actually moves.
+// When the screen renders the cursor itself, QFbScreen never composites it.
+class KoboFbCursor : public QFbCursor
+{
+public:
+    // Cursor image thresholded to black/white and converted to the framebuffer format once
+    struct Sprite
+    {
+        QImage pixels;
+        QImage mask;  // Format_Mono, set where the cursor is opaque
+        QPoint hotspot;
+    };
+
+    static const int MaxSpriteSize = 64;
+
+    static Sprite makeSprite(const QImage &image, const QPoint &hotspot, QImage::Format format);
+
+    KoboFbCursor(KoboFbScreen *screen, bool screenRendered);
+
+    void setDirty() override;
+    bool isDirty() const override;
+    QRect drawCursor(QPainter &painter) override;
+#ifndef QT_NO_CURSOR
+    void changeCursor(QCursor *widgetCursor, QWindow *window) override;
+#endif
+
+    const Sprite &sprite();
+
+private:
+    KoboFbScreen *mKoboScreen;
+    bool mScreenRendered;
+
+    Qt::CursorShape mShape = Qt::ArrowCursor;
+    QHash<int, Sprite> mSprites;
+    Sprite mBitmapSprite;
+};
+
+#endif  // KOBOFBCURSOR_H
@@ -1,10 +1,15 @@
 #include "kobofbscreen.h"
 
+#include <QtFbSupport/private/qfbbackingstore_p.h>
 #include <QtFbSupport/private/qfbwindow_p.h>
 #include <QtFbSupport/private/qfbcursor_p.h>
 
 #include <QtGui/QPainter>
 
+#include "kobolatencytracker.h"
+#include "koboredrawstats.h"
+#include "kobostartuptrace.h"
+
 // force the compiler to link i2c-tools
 extern "C"
 {
@@ -88,7 +93,6 @@ KoboFbScreen::KoboFbScreen(const QStringList &args, KoboDeviceDescriptor *koboDe
       useHardwareDithering(false),
       useSoftwareDithering(true)
 {
-    useHardwareDithering = false; // TODO: What even is this?
     setDefaultWaveform();
 }
 
@@ -118,6 +122,19 @@ void KoboFbScreen::setDefaultWaveform()
 
 KoboFbScreen::~KoboFbScreen()
 {
+    delete redrawStats;
+
+    // Its marker waiter may still be waiting on the simulated EPDC or reporting to the latency tracker
+    delete mArbiter;
+    delete touchLatency;
+
+    if (virtualEpdc)
+    {
+        delete mBlitter;
+        delete virtualEpdc;
+        return;
+    }
+
     uint8_t grayscale = originalBpp == 8 ? GRAYSCALE_8BIT : 0;
 
     if (fbink_set_fb_info(mFbFd, originalRotation, originalBpp, grayscale, &fbink_cfg) != EXIT_SUCCESS)
@@ -134,10 +151,17 @@ bool KoboFbScreen::initialize()
     QRegularExpression fbRx("fb=(.*)");
     QRegularExpression sizeRx("size=(\\d+)x(\\d+)");
     QRegularExpression dpiRx("logicaldpitarget=(\\d+)");
+    QRegularExpression coalesceRx("refreshcoalesce=(\\d+)");
 
     QString fbDevice;
     QRect userGeometry;
     int logicalDpiTarget = 0;
+    bool virtualFb = false;
+    QString virtualFbFile;
+    QString redrawStatsFile;
+    bool trackLatency = false;
+    bool logLatency = false;
+    QString dithering;
 
     // Parse arguments
     for (const QString &arg : qAsConst(mArgs))
@@ -149,10 +173,26 @@ bool KoboFbScreen::initialize()
             fbDevice = match.captured(1);
         else if (arg.contains(dpiRx, &match))
             logicalDpiTarget = match.captured(1).toInt();
+        else if (arg.contains(coalesceRx, &match))
+            refreshCoalesceMs = match.captured(1).toInt();
         else if (arg.startsWith("debug"))
             debug = true;
         else if (arg.startsWith("mouse"))
             mouse = true;
+        else if (arg.startsWith("redrawstats="))
+            redrawStatsFile = arg.section('=', 1, 1);
+        else if (arg.startsWith("dithering="))
+            dithering = arg.section('=', 1, 1);
+        else if (arg.startsWith("touchlatency"))
+        {
+            trackLatency = true;
+            logLatency = arg.section('=', 1, 1) == QLatin1String("log");
+        }
+        else if (arg.startsWith("virtualfb"))
+        {
+            virtualFb = true;
+            virtualFbFile = arg.section('=', 1, 1);
+        }
         else if (arg.startsWith("motiondebug"))
         {
             motionDebug = true;
@@ -163,28 +203,55 @@ bool KoboFbScreen::initialize()
     fbink_cfg.is_verbose = debug;
     fbink_cfg.is_quiet = !debug;
 
-    // Open framebuffer and keep it around, then setup globals.
-    if ((mFbFd = fbink_open()) < EXIT_SUCCESS)
+    if (virtualFb)
     {
-        qDebug() << "Failed to open the framebuffer";
-        return false;
+        virtualEpdc = new KoboVirtualEpdc(virtualFbFile, debug);
+        initializeVirtualFramebuffer(userGeometry.size());
     }
-
-    if (fbink_init(mFbFd, &fbink_cfg) < EXIT_SUCCESS)
+    else
     {
-        qDebug() << "Failed to initialize FBInk.";
-        return false;
+        // Open framebuffer and keep it around, then setup globals.
+        KoboStartupTrace::Phase openPhase("fbink_open");
+        if ((mFbFd = fbink_open()) < EXIT_SUCCESS)
+        {
+            qDebug() << "Failed to open the framebuffer";
+            return false;
+        }
+        openPhase.finish();
+
+        KoboStartupTrace::Phase initPhase("fbink_init");
+        if (fbink_init(mFbFd, &fbink_cfg) < EXIT_SUCCESS)
+        {
+            qDebug() << "Failed to initialize FBInk.";
+            return false;
+        }
+        initPhase.finish();
+
+        fbink_get_state(&fbink_cfg, &fbink_state);
     }
 
-    fbink_get_state(&fbink_cfg, &fbink_state);
+    mArbiter =
+        new KoboRefreshArbiter(mFbFd, fbink_state.is_sunxi, koboDevice->hasReliableMxcWaitFor, debug, this);
+    if (virtualEpdc)
+        mArbiter->setVirtualEpdc(virtualEpdc);
+    if (trackLatency)
+    {
+        touchLatency = new KoboLatencyTracker(logLatency);
+        KoboLatencyTracker *tracker = touchLatency;
+        mArbiter->setMarkerCompletedHandler([tracker](quint32 marker) { tracker->refreshCompleted(marker); });
+    }
     originalBpp = fbink_state.bpp;
     originalRotation = fbink_state.current_rota;
 
     // Don't listed to the sys interface, that's a very bad idea as Niluje explained.
     // But we use native FBInk so that's good?
+    KoboStartupTrace::Phase rotationPhase("fbink_set_fb_info and mmap");
     setScreenRotation(getScreenRotation(), originalBpp);
+    rotationPhase.finish();
 
+    KoboStartupTrace::Phase compositorPhase("initializeCompositor");
     QFbScreen::initializeCompositor();
+    compositorPhase.finish();
 
     if (mFbScreenImage.isNull())
         qDebug() << "Error, mFbScreenImage is invalid!";
@@ -196,43 +263,111 @@ bool KoboFbScreen::initialize()
                 QString::number(koboDevice->dpi / (double)logicalDpiTarget, 'g', 8).toLatin1());
     }
 
+    if (refreshCoalesceMs > 0)
+    {
+        refreshCoalesceTimer = new QTimer(this);
+        refreshCoalesceTimer->setSingleShot(true);
+        refreshCoalesceTimer->setInterval(refreshCoalesceMs);
+        connect(refreshCoalesceTimer, &QTimer::timeout, this, &KoboFbScreen::flushPendingRefresh);
+        if (debug)
+            qDebug() << "Coalescing refreshes within" << refreshCoalesceMs << "ms";
+    }
+
+    if (dithering == QLatin1String("hardware"))
+        enableDithering(false, true);
+    else if (dithering == QLatin1String("off"))
+        enableDithering(false, false);
+
+    if (!redrawStatsFile.isEmpty())
+    {
+        redrawStats = new KoboRedrawStats(redrawStatsFile);
+        if (debug && redrawStats->isOpen())
+            qDebug() << "Writing redraw statistics to" << redrawStatsFile;
+    }
+
+    KoboStartupTrace::Phase cursorPhase("cursor");
+
     // Even if cursor is disabled, because of cursor function override this still needs to be here to prevent a randomly-appearing segmentation fault.
-    mCursor = new QFbCursor(this);
+    mCursor = new KoboFbCursor(this, mouse);
     if(mouse)
     {
         previousPosition = mCursor->pos();
-        mouseTimer = new QTimer(this);
-        connect(mouseTimer, &QTimer::timeout, this, &KoboFbScreen::mouseMoveChecker);
-        mouseTimer->start(slowRefresh);
+
+        // No polling: cursor steps are triggered by pointer moves, rate limited by the DU refresh of the previous step
+        cursorRefreshTimer = new QTimer(this);
+        cursorRefreshTimer->setSingleShot(true);
+        cursorRefreshTimer->setInterval(fastRefresh);
+        connect(cursorRefreshTimer, &QTimer::timeout, this, &KoboFbScreen::cursorRefreshDone);
+
+        cursorIdleTimer = new QTimer(this);
+        cursorIdleTimer->setSingleShot(true);
+        cursorIdleTimer->setInterval(standbyDelay);
+        connect(cursorIdleTimer, &QTimer::timeout, this, &KoboFbScreen::showStandbyCursor);
+
+        cursorSaveUnder = QImage(KoboFbCursor::MaxSpriteSize, KoboFbCursor::MaxSpriteSize, mFormat);
+
         if(debug)
             qDebug() << "Initialized cursor with the screen";
-        if(standbyCursorFile.exists())
-        {
-            standbyCursor->load(standbyCursorFile.fileName());
-            if(debug)
-                qDebug() << "Using custom standby cursor";
-        }
-        else
-        {
-            if(debug)
-                qDebug() << "Using default standby cursor";
-            standbyCursor = new QImage("://resources/standby_cursor.png");
-        }
     }
 
     return true;
 }
 
+void KoboFbScreen::initializeVirtualFramebuffer(const QSize &size)
+{
+    // Clara HD unless size= says otherwise, what FBInk would report for an 8 bit framebuffer
+    virtualSize = size.isEmpty() ? QSize(1072, 1448) : size;
+    fbink_state.bpp = 8;
+    fbink_state.current_rota = RotationUR;
+    fbink_state.is_sunxi = koboDevice->isSunxi;
+    fbink_state.can_hw_invert = false;
+
+    koboDevice->physicalWidth = qRound(virtualSize.width() * 25.4 / koboDevice->dpi);
+    koboDevice->physicalHeight = qRound(virtualSize.height() * 25.4 / koboDevice->dpi);
+
+    if (debug)
+        qDebug() << "Virtual framebuffer" << virtualSize << "with the profile of" << koboDevice->modelName;
+}
+
+void KoboFbScreen::loadStandbySprite()
+{
+    QString standbyCursorPath = "://resources/standby_cursor.png";
+    if(standbyCursorFile.exists())
+    {
+        standbyCursorPath = standbyCursorFile.fileName();
+        if(debug)
+            qDebug() << "Using custom standby cursor";
+    }
+    else
+    {
+        if(debug)
+            qDebug() << "Using default standby cursor";
+    }
+    standbySprite = KoboFbCursor::makeSprite(QImage(standbyCursorPath), QPoint(0, 0), mFormat);
+}
+
 bool KoboFbScreen::setScreenRotation(ScreenRotation r, int bpp)
 {
-    int8_t rota_native = fbink_rota_canonical_to_native(r);
-    uint8_t grayscale = bpp == 8 ? GRAYSCALE_8BIT : 0;
+    if (virtualEpdc)
+    {
+        const bool swap = r == RotationCW || r == RotationCCW;
+        fbink_state.current_rota = r;
+        fbink_state.bpp = bpp;
+        fbink_state.screen_width = swap ? virtualSize.height() : virtualSize.width();
+        fbink_state.screen_height = swap ? virtualSize.width() : virtualSize.height();
+        fbink_state.scanline_stride = fbink_state.screen_width * bpp / 8;
+    }
+    else
+    {
+        int8_t rota_native = fbink_rota_canonical_to_native(r);
+        uint8_t grayscale = bpp == 8 ? GRAYSCALE_8BIT : 0;
 
-    int rv = 0;
-    if ((rv = fbink_set_fb_info(mFbFd, rota_native, bpp, grayscale, &fbink_cfg)) < EXIT_SUCCESS)
-        qDebug() << "Failed to set rotation and bpp:" << rv;
+        int rv = 0;
+        if ((rv = fbink_set_fb_info(mFbFd, rota_native, bpp, grayscale, &fbink_cfg)) < EXIT_SUCCESS)
+            qDebug() << "Failed to set rotation and bpp:" << rv;
 
-    fbink_get_state(&fbink_cfg, &fbink_state);
+        fbink_get_state(&fbink_cfg, &fbink_state);
+    }
 
     mBytesPerLine = fbink_state.scanline_stride;
     koboDevice->width = fbink_state.screen_width;
@@ -241,14 +376,24 @@ bool KoboFbScreen::setScreenRotation(ScreenRotation r, int bpp)
     if (debug)
         qDebug() << "Screen info:" << fbink_state.screen_width << fbink_state.screen_height
                  << "rotation:" << fbink_state.current_rota
-                 << "rotation canonical:" << fbink_rota_native_to_canonical(fbink_state.current_rota)
+                 << "rotation canonical:" << getScreenRotation()
                  << "bpp:" << fbink_state.bpp;
 
     mGeometry = {0, 0, koboDevice->width, koboDevice->height};
 
     mPhysicalSize = QSizeF(koboDevice->physicalWidth, koboDevice->physicalHeight);
 
-    if ((memmapInfo.bufferPtr = fbink_get_fb_pointer(mFbFd, &memmapInfo.bufferSize)) == NULL)
+    if (virtualEpdc)
+    {
+        memmapInfo.bufferPtr = virtualEpdc->map(mGeometry.width(), mGeometry.height(), mBytesPerLine);
+        memmapInfo.bufferSize = virtualEpdc->bufferSize();
+    }
+    else
+    {
+        memmapInfo.bufferPtr = fbink_get_fb_pointer(mFbFd, &memmapInfo.bufferSize);
+    }
+
+    if (memmapInfo.bufferPtr == NULL)
     {
         qDebug() << "Failed to get fb data or memmap screen";
         return false;
@@ -259,7 +404,11 @@ bool KoboFbScreen::setScreenRotation(ScreenRotation r, int bpp)
                  << "buffer size:" << memmapInfo.bufferSize;
 
     mDepth = fbink_state.bpp;
-    mFormat = determineFormat(mFbFd, mDepth);
+    if (virtualEpdc)
+        mFormat = mDepth == 8 ? QImage::Format_Grayscale8
+                              : (mDepth == 16 ? QImage::Format_RGB16 : QImage::Format_RGB32);
+    else
+        mFormat = determineFormat(mFbFd, mDepth);
 
     mFbScreenImage =
         QImage(memmapInfo.bufferPtr, mGeometry.width(), mGeometry.height(), mBytesPerLine, mFormat);
@@ -272,6 +421,9 @@ bool KoboFbScreen::setScreenRotation(ScreenRotation r, int bpp)
 
 ScreenRotation KoboFbScreen::getScreenRotation()
 {
+    // No FBInk quirks to translate through, the virtual rotation is canonical already
+    if (virtualEpdc)
+        return (ScreenRotation)fbink_state.current_rota;
     return (ScreenRotation)fbink_rota_native_to_canonical(fbink_state.current_rota);
 }
 
@@ -308,20 +460,40 @@ void KoboFbScreen::setFastScreenRefreshMode(WaveForm waveform)
 
 void KoboFbScreen::clearScreen(bool waitForCompleted)
 {
-    FBInkRect r = {0, 0, static_cast<unsigned short>(mGeometry.width()),
-                   static_cast<unsigned short>(mGeometry.height())};
-    fbink_cls(mFbFd, &fbink_cfg, &r, true);
+    // The whole screen gets refreshed anyway, pending damage is covered by this
+    pendingRefreshRect = QRect();
+    if (refreshCoalesceTimer)
+        refreshCoalesceTimer->stop();
+
+    mArbiter->clear(QRect(QPoint(0, 0), mGeometry.size()), fbink_cfg);
+    frameSequence.ref();
 
     waitForRefresh(waitForCompleted);
 }
 
 void KoboFbScreen::enableDithering(bool softwareDithering, bool hardwareDithering)
 {
+    // Where the EPDC can't dither the CPU does it instead
+    if (hardwareDithering && !koboDevice->hasHardwareDithering)
+    {
+        if (debug)
+            qDebug() << "No hardware dithering on" << koboDevice->modelName << "dithering in software";
+        hardwareDithering = false;
+        softwareDithering = true;
+    }
+
     useHardwareDithering = hardwareDithering;
-    useSoftwareDithering = softwareDithering;
+    useSoftwareDithering = softwareDithering && !hardwareDithering;
+
+    // Every refresh copies fbink_cfg, including the ones from the touch thread and the arbiter
+    fbink_cfg.dithering_mode = useHardwareDithering ? HWD_ORDERED : HWD_PASSTHROUGH;
 
     if (useSoftwareDithering)
         mScreenImageDither = mScreenImage;
+
+    if (debug)
+        qDebug() << "Dithering:"
+                 << (useHardwareDithering ? "hardware" : (useSoftwareDithering ? "software" : "off"));
 }
 
 void KoboFbScreen::ditherRegion(const QRect &region)
@@ -339,31 +511,170 @@ void KoboFbScreen::ditherRegion(const QRect &region)
     //                         mScreenImage.width(), updateHeight);
 }
 
+bool KoboFbScreen::isSmallRegion(const QRect &region) const
+{
+    return (region.width() < SMALLTHRESHOLD1 && region.height() < SMALLTHRESHOLD1) ||
+           (region.width() + region.height() < SMALLTHRESHOLD2);
+}
+
+void KoboFbScreen::queueRefresh(const QRect &region)
+{
+    // Small updates are mostly direct input feedback (highlights, text cursor),
+    // they skip the coalescing window to keep their latency
+    if (!refreshCoalesceTimer || isSmallRegion(region))
+    {
+        doManualRefresh(region);
+        return;
+    }
+
+    pendingRefreshRect = pendingRefreshRect.united(region);
+    if (!refreshCoalesceTimer->isActive())
+        refreshCoalesceTimer->start();
+
+    if (motionDebug)
+        qDebug() << "Coalescing refresh of" << region << "pending:" << pendingRefreshRect;
+}
+
+void KoboFbScreen::flushPendingRefresh()
+{
+    if (pendingRefreshRect.isEmpty())
+        return;
+
+    QRect region = pendingRefreshRect;
+    pendingRefreshRect = QRect();
+    doManualRefresh(region);
+}
+
+void KoboFbScreen::beginRefreshTransaction()
+{
+    // Also reopens a transaction whose commit is still waiting for the repaints
+    if (transactionDepth++ > 0 || transactionOpen)
+        return;
+
+    transactionOpen = true;
+    if (!transactionTimer)
+    {
+        transactionTimer = new QTimer(this);
+        transactionTimer->setSingleShot(true);
+        transactionTimer->setInterval(transactionTimeout);
+        connect(transactionTimer, &QTimer::timeout, this, [this] {
+            qDebug() << "Refresh transaction still open after" << transactionTimeout << "ms, committing it";
+            transactionDepth = 0;
+            finishRefreshTransaction();
+        });
+    }
+    transactionTimer->start();
+
+    // A coalesced refresh still waiting joins the transaction
+    if (refreshCoalesceTimer && refreshCoalesceTimer->isActive())
+    {
+        refreshCoalesceTimer->stop();
+        transactionUnhinted += pendingRefreshRect;
+        pendingRefreshRect = QRect();
+    }
+
+    if (motionDebug)
+        qDebug() << "Refresh transaction started";
+}
+
+void KoboFbScreen::commitRefreshTransaction(WaveForm waveform)
+{
+    if (transactionDepth == 0 || --transactionDepth > 0)
+        return;
+
+    // The widgets repaint and the screen redraws from posted events, a zero timer runs after all of them
+    transactionWaveform = waveform;
+    QTimer::singleShot(0, this, &KoboFbScreen::finishRefreshTransaction);
+}
+
+void KoboFbScreen::finishRefreshTransaction()
+{
+    if (!transactionOpen || transactionDepth > 0)
+        return;
+
+    transactionOpen = false;
+    transactionTimer->stop();
+
+    QRect region = transactionUnhinted.boundingRect();
+    for (const QRect &rect : qAsConst(transactionHinted))
+        region = region.united(rect);
+
+    // One refresh for all of it: the requested waveform, the hint if all damage shared one,
+    // otherwise the usual policy, which turns a transaction covering the screen into a full refresh
+    const bool singleHint = transactionUnhinted.isEmpty() && transactionHinted.size() == 1;
+    const int hint = singleHint ? transactionHinted.firstKey() : -1;
+    transactionUnhinted = QRegion();
+    transactionHinted.clear();
+
+    if (motionDebug)
+        qDebug() << "Refresh transaction committed:" << region;
+
+    if (region.isEmpty())
+        return;
+
+    if (transactionWaveform != WaveForm_AUTO)
+        doManualRefresh(region, true, transactionWaveform);
+    else if (singleHint)
+        doManualRefresh(region, true, hint);
+    else
+        doManualRefresh(region);
+}
+
 void KoboFbScreen::doManualRefresh(const QRect &region, bool forceMode, WFM_MODE_INDEX_T waveformMode)
 {
     bool isFullRefresh = region.width() >= mGeometry.width() - FULLSCREENTOLERANCE &&
                          region.height() >= mGeometry.height() - FULLSCREENTOLERANCE;
 
-    bool isSmall = (region.width() < SMALLTHRESHOLD1 && region.height() < SMALLTHRESHOLD1) ||
-                   (region.width() + region.height() < SMALLTHRESHOLD2);
+    bool isSmall = isSmallRegion(region);
 
+    // Work on a copy, the touch thread reads fbink_cfg for its own refreshes
+    FBInkConfig cfg = fbink_cfg;
     if (isFullRefresh)
-        fbink_cfg.wfm_mode = this->waveFormFullscreen;
+        cfg.wfm_mode = this->waveFormFullscreen;
     else if (isSmall)
-        fbink_cfg.wfm_mode = this->waveFormFast;
+        cfg.wfm_mode = this->waveFormFast;
     else
-        fbink_cfg.wfm_mode = this->waveFormPartial;
+        cfg.wfm_mode = this->waveFormPartial;
 
     // Needed for mouse
     if(forceMode)
-        fbink_cfg.wfm_mode = waveformMode;
+        cfg.wfm_mode = waveformMode;
 
     if(flashingEnabled == true)
-        fbink_cfg.is_flashing = isFullRefresh;
+        cfg.is_flashing = isFullRefresh;
     else
-        fbink_cfg.is_flashing = false;
+        cfg.is_flashing = false;
+
+    if (!forceMode)
+    {
+        const qint64 deadline = pageTurnDeadline.fetchAndStoreRelaxed(0);
+        if (deadline && QDeadlineTimer::current().deadline() <= deadline)
+        {
+            cfg.wfm_mode = pageTurnWaveform;
+            cfg.is_flashing = pageTurnFlashing;
+        }
+        else if (deadline && debug)
+        {
+            qDebug() << "Page turn refresh expired before a refresh came";
+        }
+    }
 
-    int rv = fbink_refresh(mFbFd, region.top(), region.left(), region.width(), region.height(), &fbink_cfg);
+    QElapsedTimer submitTimer;
+    submitTimer.start();
+    int rv;
+    if (touchLatency && touchLatency->wantsMarker())
+    {
+        // Answers a touch, its completion is what the latency is measured to
+        const quint32 marker = mArbiter->refreshTracked(region, cfg);
+        touchLatency->refreshSubmitted(marker);
+        rv = marker != RefreshMarker_Failed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    else
+    {
+        rv = mArbiter->refresh(region, cfg);
+    }
+    if (redrawStats)
+        redrawStats->addRefresh(region, cfg.wfm_mode, cfg.is_flashing, submitTimer.nsecsElapsed() / 1000);
 
 // Even more logs, don't compile them at default
 #if true == false
@@ -376,17 +687,108 @@ void KoboFbScreen::doManualRefresh(const QRect &region, bool forceMode, WFM_MODE
     }
 #endif
 
-    if (rv != EXIT_SUCCESS && errno == EPERM)
+    if (rv == EXIT_SUCCESS)
+        waitForRefresh();
+
+    if (pendingRefreshRect.isEmpty())
+        emit refreshIdle();
+}
+
+void KoboFbScreen::setPageTurnRefresh(bool enabled, WaveForm waveform, bool flashing)
+{
+    if (debug)
+        qDebug() << "Page turn refresh:" << enabled << waveform << "flashing:" << flashing;
+    pageTurnWaveform = waveform;
+    pageTurnFlashing = flashing;
+    pageTurnRefresh = enabled;
+    if (!enabled)
+        pageTurnDeadline.storeRelaxed(0);
+}
+
+void KoboFbScreen::armPageTurnRefresh()
+{
+    if (pageTurnRefresh)
+        pageTurnDeadline.storeRelaxed(QDeadlineTimer(pageTurnArmMs).deadline());
+}
+
+quint32 KoboFbScreen::submitRefresh(const QRegion &region, WaveForm waveform, int flags)
+{
+    FBInkConfig cfg = fbink_cfg;
+    cfg.wfm_mode = waveform;
+    cfg.is_flashing = flags & RefreshFlag_Flashing;
+    if (flags & RefreshFlag_HardwareDithering)
+        cfg.dithering_mode = HWD_ORDERED;
+
+    // Nothing of it on screen, nothing to refresh
+    const QRegion clipped = region.intersected(mGeometry);
+    if (clipped.isEmpty())
+        return RefreshMarker_Failed;
+
+    QElapsedTimer submitTimer;
+    submitTimer.start();
+
+    quint32 marker = RefreshMarker_Failed;
+    if (clipped.rectCount() > 4)
     {
-        if(debug)
-            qDebug() << "QPA: Detected framebuffer freeze, attempting to fix ...";
-        unsigned long arg = VESA_NO_BLANKING;
-        if (ioctl(mFbFd, FBIOBLANK, arg) == EXIT_SUCCESS)
-            rv = fbink_refresh(mFbFd, region.top(), region.left(), region.width(), region.height(), &fbink_cfg);
+        // Past a few rects the EPDC is better off with one update
+        marker = mArbiter->refreshTracked(clipped.boundingRect(), cfg);
+    }
+    else
+    {
+        // One update per rect. The highest marker is the one sent last, or Deferred which completes after
+        // all of them, so waiting for it covers the whole region
+        for (const QRect &rect : clipped)
+            marker = qMax(marker, mArbiter->refreshTracked(rect, cfg));
     }
 
-    if (rv == EXIT_SUCCESS)
-        waitForRefresh();
+    if (touchLatency)
+        touchLatency->refreshSubmitted(marker);
+    if (redrawStats)
+        redrawStats->addRefresh(clipped.boundingRect(), cfg.wfm_mode, cfg.is_flashing,
+                                submitTimer.nsecsElapsed() / 1000);
+    return marker;
+}
+
+bool KoboFbScreen::waitForMarker(quint32 marker, int timeoutMs)
+{
+    return mArbiter->waitForMarker(marker, timeoutMs);
+}
+
+bool KoboFbScreen::isMarkerComplete(quint32 marker)
+{
+    return mArbiter->isMarkerComplete(marker);
+}
+
+QImage KoboFbScreen::screenBuffer(ScreenBuffer buffer, quint32 *sequence)
+{
+    if (sequence)
+        *sequence = frameSequence.loadAcquire();
+
+    // Built on const data: a view that can't write back, modifying it detaches a copy
+    const QImage *image = nullptr;
+    switch (buffer)
+    {
+        case ScreenBuffer_Composed:
+            image = &mScreenImage;
+            break;
+        case ScreenBuffer_Dithered:
+            if (!useSoftwareDithering)
+                return QImage();
+            image = &mScreenImageDither;
+            break;
+        case ScreenBuffer_Framebuffer:
+            image = &mFbScreenImage;
+            break;
+    }
+    if (!image || image->isNull())
+        return QImage();
+
+    return QImage(image->constBits(), image->width(), image->height(), image->bytesPerLine(), image->format());
+}
+
+quint32 KoboFbScreen::screenBufferSequence() const
+{
+    return frameSequence.loadAcquire();
 }
 
 void KoboFbScreen::setFlashing(bool v)
@@ -425,10 +827,23 @@ QRegion KoboFbScreen::doRedraw()
         t = new QElapsedTimer();
         t->start();
     }
+    if (redrawStats)
+        redrawStats->beginFrame();
+    const qint64 redrawStartUs = touchLatency ? KoboLatencyTracker::nowUs() : 0;
+
     QRegion touched = QFbScreen::doRedraw();
 
     if (touched.isEmpty())
+    {
+        if (redrawStats)
+            redrawStats->endFrame();
         return touched;
+    }
+
+    if (redrawStats)
+        redrawStats->composed();
+    if (touchLatency)
+        touchLatency->redrawStarted(redrawStartUs);
 
     QRect r(*touched.begin());
     for (const QRect &rect : touched)
@@ -440,31 +855,57 @@ QRegion KoboFbScreen::doRedraw()
     if (useSoftwareDithering)
         ditherRegion(r);
 
+    if (redrawStats)
+        redrawStats->dithered();
+
+    const QImage &source = useSoftwareDithering ? mScreenImageDither : mScreenImage;
     mBlitter->setCompositionMode(QPainter::CompositionMode_Source);
+
+    // Fast ink writes the same framebuffer from the touch thread
+    QMutexLocker inkLocker(&fastInkMutex);
     for (const QRect &rect : touched)
     {
-        if(mouse)
+        mBlitter->drawImage(rect, source, rect);
+
+        // The cursor is an overlay: keep the new pixels under it and put it back on top,
+        // so the refresh below already shows the final image
+        const QRect covered = rect.intersected(cursorRect);
+        if (!covered.isEmpty())
         {
-            if(motionDebug && rect.x() == mCursor->pos().x() && rect.y() == mCursor->pos().y())
-                qDebug() << "Detected overwriting cursor position";
-            // This function can be called only once, then it sets to 0,0
-            dirtyRect = mCursor->dirtyRect();
-            if(motionDebug)
-                qDebug() << "Dirty cursor position:" << dirtyRect;
-            if(rect == dirtyRect && renderCursor == false)
-            {
-                if(motionDebug)
-                    qDebug() << "Requested cursor overwrite even though it's not allowed. Saving this fragment for later.";
-                savedCursorRects.push_back(dirtyRect);
-            }
-            else
-                mBlitter->drawImage(rect, useSoftwareDithering ? mScreenImageDither : mScreenImage, rect);
+            if (motionDebug)
+                qDebug() << "Repaint overlaps the cursor, compositing it into" << covered;
+            saveCursorBackground(covered);
+            compositeCursor(covered);
         }
-        else
-            mBlitter->drawImage(rect, useSoftwareDithering ? mScreenImageDither : mScreenImage, rect);
     }
+    inkLocker.unlock();
 
-    doManualRefresh(r);
+    frameSequence.ref();
+
+    if (redrawStats)
+        redrawStats->blitted();
+
+    QRegion unhinted;
+    QMap<int, QRect> hinted;
+    classifyDamage(touched, unhinted, hinted);
+
+    if (transactionOpen)
+    {
+        // The pixels are in the framebuffer, the commit refreshes everything in one go
+        transactionUnhinted += unhinted;
+        for (auto it = hinted.constBegin(); it != hinted.constEnd(); ++it)
+            transactionHinted[it.key()] = transactionHinted.value(it.key()).united(it.value());
+    }
+    else
+    {
+        if (!unhinted.isEmpty())
+            queueRefresh(unhinted.boundingRect());
+        for (auto it = hinted.constBegin(); it != hinted.constEnd(); ++it)
+            doManualRefresh(it.value(), true, it.key());
+    }
+
+    if (redrawStats)
+        redrawStats->endFrame();
 
     if (motionDebug)
     {
@@ -475,147 +916,420 @@ QRegion KoboFbScreen::doRedraw()
     return touched;
 }
 
-void KoboFbScreen::mouseMoveChecker()
+void KoboFbScreen::setRedrawWorkload(const QString &name)
 {
-    // Increase speed of cursor rendering if it's moving
-    if(previousPosition != mCursor->pos())
+    if (redrawStats)
+        redrawStats->setWorkload(name);
+}
+
+void KoboFbScreen::setWaveformHintRegion(const QString &name, const QRect &region, WaveForm waveform)
+{
+    if (region.isEmpty())
+        waveformHintRegions.remove(name);
+    else
+        waveformHintRegions.insert(name, {region, WFM_MODE_INDEX_T(waveform)});
+
+    if (debug)
+        qDebug() << "Waveform hint" << name << region << waveform;
+}
+
+int KoboFbScreen::waveformFromHint(const QVariant &hint) const
+{
+    bool isNumber = false;
+    const int number = hint.toInt(&isNumber);
+    if (isNumber)
+        return number;
+
+    const QString name = hint.toString().toUpper();
+    if (name == "UI" || name == "DU")
+        return WFM_DU;
+    if (name == "IMAGE" || name == "GC16")
+        return WFM_GC16;
+    if (name == "TEXT")
+        return koboDevice->mark >= 7 ? WFM_REAGL : WFM_GL16;
+    if (name == "GL16")
+        return WFM_GL16;
+    if (name == "REAGL")
+        return WFM_REAGL;
+    if (name == "REAGLD")
+        return WFM_REAGLD;
+    if (name == "A2")
+        return WFM_A2;
+    if (name == "GC4")
+        return WFM_GC4;
+    if (name == "AUTO")
+        return WFM_AUTO;
+    return -1;
+}
+
+void KoboFbScreen::classifyDamage(const QRegion &touched, QRegion &unhinted, QMap<int, QRect> &hinted)
+{
+    QRegion remaining = touched;
+
+    // Registered regions first, they are the more specific hint
+    for (const WaveformHint &hint : qAsConst(waveformHintRegions))
     {
-        if(changedTime == false)
-        {
-            if (motionDebug) qDebug() << "Cleaning at not moving cursor:" << stopRect;
-            mBlitter->setCompositionMode(QPainter::CompositionMode_Source);
-            mBlitter->drawImage(previousPosition, cleanStopFragment);
-            // We need full actually, and the default is small
-            doManualRefresh(stopRect, true, this->waveFormPartial);
-            waitForRefresh(true);
-            doManualRefresh(stopRect, true, this->waveFormPartial);
-            /* Debug
-            QImage tmp{"/cursor.png"};
-            mBlitter->drawImage(QRect{stopRect.x(), stopRect.y(), 100, 100}, tmp, QRect{0, 100, 100, 100});
-            doManualRefresh(QRect{stopRect.x(), stopRect.y(), 100, 100});
-        */
-        }
+        const QRegion covered = remaining.intersected(hint.region);
+        if (covered.isEmpty())
+            continue;
+        hinted[hint.waveform] = hinted.value(hint.waveform).united(covered.boundingRect());
+        remaining -= covered;
+    }
 
-        if (motionDebug)
-            qDebug() << "Mouse moved:" << mCursor->pos();
-        if (motionDebug)
-            qDebug() << "Cursor needs refreshing:" << mCursor->isDirty();
-
-        // Save the clean position of the cursor
-        // To avoid ghosting
-        stopRect.setX(mCursor->pos().x());
-        stopRect.setY(mCursor->pos().y());
-        // Get the size of the latest cursor
-        int x;
-        int y;
-        int fallbackSize = 48;
-        if(savedCursorRects.length() != 0)
-        {
-            x = savedCursorRects[savedCursorRects.length() - 1].width();
-            y = savedCursorRects[savedCursorRects.length() - 1].height();
-            if(x == 0)
-                x = fallbackSize;
-            if(y == 0)
-                y = fallbackSize;
-        }
-        else
-        {
-            y = fallbackSize;
-            x = fallbackSize;
-        }
-        stopRect.setWidth(x);
-        stopRect.setHeight(y);
-        if(motionDebug && x == fallbackSize && y == fallbackSize)
-            qDebug() << "Failed to get cursor size";
-        if(useSoftwareDithering)
-            cleanStopFragment = mScreenImageDither.copy(stopRect);
+    // Then the windows, top most first
+    const QList<QFbWindow *> stack = windows();
+    for (QFbWindow *fbWindow : stack)
+    {
+        if (remaining.isEmpty())
+            break;
+
+        const QVariant hint = fbWindow->window()->property(KoboWaveformHintProperty);
+        const QRect geometry = fbWindow->geometry();
+        const QRegion covered = remaining.intersected(geometry);
+        if (covered.isEmpty())
+            continue;
+
+        // Lower windows are hidden there whether this one has a hint or not
+        remaining -= covered;
+        const int waveform = hint.isValid() ? waveformFromHint(hint) : -1;
+        if (waveform < 0)
+            unhinted += covered;
         else
-            cleanStopFragment = mScreenImage.copy(stopRect);
-        /* Debug
-        cleanStopFragment.save("/tmp/cleanStopFragment.png", nullptr, -1);
-    */
-
-        // Actually request rendering it
-        renderCursor = true;
-        if(mCursor->pos() != previousPosition)
-        {
-            mCursor->updateMouseStatus();
-            mCursor->drawCursor(*mBlitter);
-            doManualRefresh(stopRect, true, this->waveFormFast);
-        }
+            hinted[waveform] = hinted.value(waveform).united(covered.boundingRect());
+    }
 
-        mBlitter->setCompositionMode(QPainter::CompositionMode_Source);
-        // Clean previous ones
-        for(int i = 0; i < savedCursorRects.length(); i++)
-        {
-            if (motionDebug)
-                qDebug() << "Clearing previous cursor:" << savedCursorRects[i];
-            mBlitter->drawImage(savedCursorRects[i], useSoftwareDithering ? mScreenImageDither : mScreenImage, savedCursorRects[i]);
-            doManualRefresh(savedCursorRects[i]);
-        }
-        if (motionDebug)
-            qDebug() << "Cleared previous cursor count:" << savedCursorRects.length();
-        // Save the latest width and height of the cursor to clean it in slow start
-        savedCursorRects.clear();
-        renderCursor = false;
-
-        countCycles = 0;
-        if(changedTime == false)
+    unhinted += remaining;
+}
+
+void KoboFbScreen::scheduleCursorUpdate()
+{
+    if (!mouse || !cursorRefreshTimer)
+        return;
+
+    // Only one cursor step in flight, moves in between are merged into the next one
+    if (cursorRefreshTimer->isActive())
+    {
+        cursorUpdatePending = true;
+        return;
+    }
+
+    updateCursor();
+}
+
+void KoboFbScreen::cursorShapeChanged()
+{
+    cursorShapeDirty = true;
+    scheduleCursorUpdate();
+}
+
+static inline void copyPixels(uchar *dst, int dstStride, const uchar *src, int srcStride, int rowBytes, int rows)
+{
+    for (int y = 0; y < rows; y++)
+        memcpy(dst + y * dstStride, src + y * srcStride, rowBytes);
+}
+
+void KoboFbScreen::restoreCursorBackground()
+{
+    if (cursorRect.isNull())
+        return;
+
+    const int bpp = mFbScreenImage.depth() / 8;
+    copyPixels(memmapInfo.bufferPtr + cursorRect.y() * mBytesPerLine + cursorRect.x() * bpp, mBytesPerLine,
+               cursorSaveUnder.constBits(), cursorSaveUnder.bytesPerLine(), cursorRect.width() * bpp,
+               cursorRect.height());
+}
+
+void KoboFbScreen::saveCursorBackground(const QRect &area)
+{
+    const int bpp = mFbScreenImage.depth() / 8;
+    const QPoint offset = area.topLeft() - cursorRect.topLeft();
+    copyPixels(cursorSaveUnder.bits() + offset.y() * cursorSaveUnder.bytesPerLine() + offset.x() * bpp,
+               cursorSaveUnder.bytesPerLine(), memmapInfo.bufferPtr + area.y() * mBytesPerLine + area.x() * bpp,
+               mBytesPerLine, area.width() * bpp, area.height());
+}
+
+void KoboFbScreen::compositeCursor(const QRect &area)
+{
+    const int bpp = mFbScreenImage.depth() / 8;
+    const QPoint offset = area.topLeft() - cursorOrigin;
+    uchar *fb = memmapInfo.bufferPtr + area.y() * mBytesPerLine + area.x() * bpp;
+    for (int y = 0; y < area.height(); y++)
+    {
+        const uchar *mask = cursorSprite.mask.constScanLine(offset.y() + y);
+        const uchar *src = cursorSprite.pixels.constScanLine(offset.y() + y) + offset.x() * bpp;
+        uchar *dst = fb + y * mBytesPerLine;
+        for (int x = 0; x < area.width(); x++)
         {
-            if (motionDebug)
-                qDebug() << "Rendering mouse and starting fast refresh mode";
-            changedTime = true;
-            mouseTimer->stop();
-            mouseTimer->start(fastRefresh);
+            const int sx = offset.x() + x;
+            if (mask[sx >> 3] & (0x80 >> (sx & 7)))
+                memcpy(dst + x * bpp, src + x * bpp, bpp);
         }
-        previousPosition = mCursor->pos();
+    }
+}
+
+bool KoboFbScreen::stageSurface(const QString &name, const QImage &image, const QPoint &position)
+{
+    if (image.isNull())
+    {
+        stagedSurfaces.remove(name);
+        return false;
+    }
+
+    StagedSurface surface;
+    surface.position = position;
+    surface.composed = image.convertToFormat(mScreenImage.format());
+    if (useSoftwareDithering)
+    {
+        // ditherBuffer expects rows without padding
+        const int alignedWidth = (image.width() + 3) & ~3;
+        const QImage source = surface.composed.copy(0, 0, alignedWidth, image.height());
+        surface.pixels = QImage(alignedWidth, image.height(), mFbScreenImage.format());
+        ditherBuffer(surface.pixels.bits(), const_cast<uchar *>(source.constBits()), alignedWidth,
+                     image.height());
     }
     else
     {
-       if(changedTime == true)
-        {
-            if(countCycles == cyclesUntilSlow)
-            {
-                if (motionDebug)
-                    qDebug() << "Mouse stopped moving, returning to slow refreshes";
-
-                // Make sure the cursor is visible
-                waitForRefresh(true);
-                mBlitter->setCompositionMode(QPainter::CompositionMode_Source);
-                mBlitter->drawImage(mCursor->pos(), *standbyCursor);
-                QRect cursorStandbyRect{mCursor->pos().x(), mCursor->pos().y(), standbyCursor->width(), standbyCursor->height()};
-                doManualRefresh(cursorStandbyRect, true, this->waveFormPartial);
-
-                changedTime = false;
-                countCycles = 0;
-                mouseTimer->stop();
-                mouseTimer->start(slowRefresh);
-            }
-            else
-                countCycles = countCycles + 1;
-       }
+        surface.pixels = surface.composed.convertToFormat(mFbScreenImage.format());
+    }
+
+    stagedSurfaces.insert(name, surface);
+    if (debug)
+        qDebug() << "Staged surface" << name << QRect(position, image.size());
+    return true;
+}
+
+quint32 KoboFbScreen::commitSurface(const QString &name, WaveForm waveform, int flags)
+{
+    auto it = stagedSurfaces.constFind(name);
+    if (it == stagedSurfaces.constEnd())
+        return 0;
+
+    const StagedSurface &surface = it.value();
+    const QRect target = QRect(surface.position, surface.composed.size()).intersected(mGeometry);
+    if (target.isEmpty())
+        return 0;
+
+    const QPoint offset = target.topLeft() - surface.position;
+    const int bpp = mFbScreenImage.depth() / 8;
+
+    // Straight into the framebuffer, the refresh goes out before anything else is brought in line
+    copyPixels(memmapInfo.bufferPtr + target.y() * mBytesPerLine + target.x() * bpp, mBytesPerLine,
+               surface.pixels.constScanLine(offset.y()) + offset.x() * bpp, surface.pixels.bytesPerLine(),
+               target.width() * bpp, target.height());
+
+    const QRect covered = target.intersected(cursorRect);
+    if (!covered.isEmpty())
+    {
+        saveCursorBackground(covered);
+        compositeCursor(covered);
+    }
+
+    frameSequence.ref();
+    const quint32 marker = submitRefresh(target, waveform, flags);
+
+    // What Qt composes from has to show the surface too, or the next repaint brings the old content back
+    const int screenBpp = mScreenImage.depth() / 8;
+    copyPixels(mScreenImage.bits() + target.y() * mScreenImage.bytesPerLine() + target.x() * screenBpp,
+               mScreenImage.bytesPerLine(),
+               surface.composed.constScanLine(offset.y()) + offset.x() * screenBpp,
+               surface.composed.bytesPerLine(), target.width() * screenBpp, target.height());
+    if (useSoftwareDithering && mScreenImageDither.size() == mScreenImage.size())
+        copyPixels(mScreenImageDither.bits() + target.y() * mScreenImageDither.bytesPerLine() + target.x(),
+                   mScreenImageDither.bytesPerLine(), surface.pixels.constScanLine(offset.y()) + offset.x(),
+                   surface.pixels.bytesPerLine(), target.width(), target.height());
+
+    QRegion remaining(target);
+    const QList<QFbWindow *> stack = windows();
+    for (QFbWindow *fbWindow : stack)
+    {
+        QFbBackingStore *backingStore = fbWindow->backingStore();
+        const QRegion part = remaining.intersected(fbWindow->geometry());
+        if (!backingStore || part.isEmpty())
+            continue;
+
+        const QPoint windowOrigin = fbWindow->geometry().topLeft();
+        backingStore->lock();
+        QPainter painter(backingStore->paintDevice());
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.setClipRegion(part.translated(-windowOrigin));
+        painter.drawImage(surface.position - windowOrigin, surface.composed);
+        painter.end();
+        backingStore->unlock();
+
+        remaining -= part;
+    }
+
+    if (debug)
+        qDebug() << "Committed surface" << name << target << "marker:" << marker;
+    return marker;
+}
+
+void KoboFbScreen::placeCursor(const KoboFbCursor::Sprite &sprite, const QPoint &pos)
+{
+    cursorSprite = sprite;
+    cursorOrigin = pos - sprite.hotspot;
+    cursorRect = QRect(cursorOrigin, sprite.pixels.size()).intersected(QRect(QPoint(0, 0), mGeometry.size()));
+    if (cursorRect.isEmpty())
+    {
+        cursorRect = QRect();
+        return;
+    }
+
+    saveCursorBackground(cursorRect);
+    compositeCursor(cursorRect);
+}
+
+bool KoboFbScreen::updateCursor()
+{
+    if(previousPosition == mCursor->pos() && !cursorShapeDirty)
+        return false;
+
+    cursorIdleTimer->stop();
+    cursorShapeDirty = false;
+
+    if (motionDebug)
+        qDebug() << "Mouse moved:" << mCursor->pos();
+
+    const QRect oldRect = cursorRect;
+    restoreCursorBackground();
+
+    // The standby cursor may sit on grays, which DU won't restore
+    if (!cursorMoving && !oldRect.isNull())
+    {
+        if (motionDebug) qDebug() << "Cleaning at not moving cursor:" << oldRect;
+        doManualRefresh(oldRect, true, this->waveFormPartial);
+    }
+
+    placeCursor(mCursor->sprite(), mCursor->pos());
+
+    // One DU refresh takes care of both the old and the new position
+    QRect refreshRect = cursorMoving ? oldRect.united(cursorRect) : cursorRect;
+    if (!refreshRect.isEmpty())
+        doManualRefresh(refreshRect, true, this->waveFormFast);
+
+    if (motionDebug && cursorMoving == false)
+        qDebug() << "Rendering mouse, cursor started moving";
+    cursorMoving = true;
+    previousPosition = mCursor->pos();
+
+    cursorRefreshTimer->start();
+    return true;
+}
+
+void KoboFbScreen::cursorRefreshDone()
+{
+    // Don't start the next step before the DU of this one is done, they would collide on the EPDC
+    waitForRefresh(true);
+
+    if (cursorUpdatePending)
+    {
+        cursorUpdatePending = false;
+        if (updateCursor())
+            return;
     }
+
+    // Nothing moved during this step, the standby cursor is drawn once and then we stay idle
+    if (cursorMoving)
+        cursorIdleTimer->start();
+}
+
+void KoboFbScreen::showStandbyCursor()
+{
+    if (motionDebug)
+        qDebug() << "Mouse stopped moving, drawing the standby cursor";
+
+    // Make sure the cursor is visible
+    waitForRefresh(true);
+
+    // Loaded the first time the mouse rests, applications without a mouse never decode it
+    if (standbySprite.pixels.isNull())
+        loadStandbySprite();
+
+    const QRect oldRect = cursorRect;
+    restoreCursorBackground();
+    placeCursor(standbySprite, mCursor->pos());
+
+    // Not DU, this also cleans the ghosting left by the moving cursor
+    QRect refreshRect = oldRect.united(cursorRect);
+    if (!refreshRect.isEmpty())
+        doManualRefresh(refreshRect, true, this->waveFormPartial);
+
+    cursorMoving = false;
 }
 
 
 void KoboFbScreen::doSunxiPenRefresh()
 {
-    // NOTE: On sunxi, send a !pen refresh on pen up because otherwise the driver
-    // softlocks,
-    //       and ultimately trips a reboot watchdog...
-    // NOTE: Nickel also toggles pen mode *off* before doing that...
-    //       Let's do the same, as we can still somewhat reliably kill the kernel
-    //       one way or another otherwise...
-    // NOTE: That means that any other competing refresh is potentially dangerous:
-    //       make sure only pen refreshes are sent while in pen mode!
-    fbink_sunxi_toggle_ntx_pen_mode(mFbFd, false);
+    // The arbiter sends the !pen refresh the driver needs once the pen stays lifted
+    mArbiter->penUp();
+}
+
+void KoboFbScreen::penDown()
+{
+    mArbiter->penDown();
+}
+
+void KoboFbScreen::setFastInk(const QRect &area, int strokeWidth)
+{
+    QMutexLocker locker(&fastInkMutex);
+    fastInkArea = area.intersected(mGeometry);
+    fastInkWidth = qMax(1, strokeWidth);
 
-    const WFM_MODE_INDEX_T pen_wfm = fbink_cfg.wfm_mode;
-    fbink_cfg.wfm_mode = WFM_GL16;
-    fbink_refresh(mFbFd, 0, 0, 0, 0, &fbink_cfg);
-    fbink_cfg.wfm_mode = pen_wfm;
+    if (debug)
+        qDebug() << "Fast ink area:" << fastInkArea << "stroke width:" << fastInkWidth;
+}
 
-    fbink_sunxi_toggle_ntx_pen_mode(mFbFd, true);
+bool KoboFbScreen::drawFastInk(const QPoint &from, const QPoint &to)
+{
+    QMutexLocker locker(&fastInkMutex);
+    if (fastInkArea.isEmpty() || (!fastInkArea.contains(from) && !fastInkArea.contains(to)))
+        return false;
+
+    // Bresenham, stamping a square of the stroke width on every step
+    const int bpp = mFbScreenImage.depth() / 8;
+    const int half = fastInkWidth / 2;
+    const int dx = qAbs(to.x() - from.x()), sx = from.x() < to.x() ? 1 : -1;
+    const int dy = -qAbs(to.y() - from.y()), sy = from.y() < to.y() ? 1 : -1;
+    int err = dx + dy;
+    QPoint p = from;
+    for (;;)
+    {
+        const QRect stamp =
+            QRect(p.x() - half, p.y() - half, fastInkWidth, fastInkWidth).intersected(fastInkArea);
+        for (int y = stamp.top(); y <= stamp.bottom(); y++)
+            memset(memmapInfo.bufferPtr + y * mBytesPerLine + stamp.left() * bpp, 0, stamp.width() * bpp);
+
+        if (p == to)
+            break;
+        const int e2 = 2 * err;
+        if (e2 >= dy)
+        {
+            err += dy;
+            p.rx() += sx;
+        }
+        if (e2 <= dx)
+        {
+            err += dx;
+            p.ry() += sy;
+        }
+    }
+
+    const QRect dirty =
+        QRect(from, to).normalized().adjusted(-half, -half, half + 1, half + 1).intersected(fastInkArea);
+    if (dirty.isEmpty())
+        return false;
+
+    // DU on black only, don't wait for it: the next segment is already coming
+    FBInkConfig inkCfg = fbink_cfg;
+    inkCfg.wfm_mode = WFM_DU;
+    inkCfg.is_flashing = false;
+    inkCfg.dithering_mode = HWD_PASSTHROUGH;  // black ink, nothing to dither
+    frameSequence.ref();
+    mArbiter->refresh(dirty, inkCfg);
+
+    if (motionDebug)
+        qDebug() << "Fast ink" << from << to << "refresh" << dirty;
+    return true;
 }
 
 void KoboFbScreen::waitForRefresh(bool force)
@@ -626,7 +1340,7 @@ void KoboFbScreen::waitForRefresh(bool force)
         {
             if(debug)
                 qDebug() << "Doing a probably good wait method";
-            fbink_wait_for_complete(mFbFd, LAST_MARKER);
+            mArbiter->waitForLastRefresh();
         }
         else
         {
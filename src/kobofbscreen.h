@@ -10,14 +10,21 @@
 
 #include <cstring>
 
+#include <QAtomicInt>
+#include <QMutex>
+
 #include "dither.h"
 #include "eink/mxcfb-kobo.h"
 #include "einkenums.h"
 #include "fbink.h"
 #include "kobodevicedescriptor.h"
+#include "kobofbcursor.h"
+#include "koborefresharbiter.h"
+#include "kobovirtualepdc.h"
 
+class KoboLatencyTracker;
+class KoboRedrawStats;
 class QPainter;
-class QFbCursor;
 
 class KoboFbScreen : public QFbScreen
 {
@@ -40,17 +47,43 @@ public:
 
     void doManualRefresh(const QRect &region, bool forceMode = false, WFM_MODE_INDEX_T waveformMode = WFM_AUTO);
 
+    // Until the matching commit repaints still reach the framebuffer, their refreshes are merged into one
+    void beginRefreshTransaction();
+
+    void commitRefreshTransaction(WaveForm waveform);
+
+    // An empty region refreshes the whole screen, flags are RefreshFlag values
+    quint32 submitRefresh(const QRegion &region, WaveForm waveform, int flags);
+
+    bool waitForMarker(quint32 marker, int timeoutMs);
+
+    // A view without copy, valid until the screen is rotated. The sequence changes with every write to
+    // the framebuffer, reading it again after using the view tells whether it was stable meanwhile.
+    QImage screenBuffer(ScreenBuffer buffer, quint32 *sequence);
+
+    quint32 screenBufferSequence() const;
+
+    // Converted and dithered when staged, so the commit is a copy into the framebuffer and a refresh.
+    // A null image drops the surface.
+    bool stageSurface(const QString &name, const QImage &image, const QPoint &position);
+
+    quint32 commitSurface(const QString &name, WaveForm waveform, int flags);
+
+    bool isMarkerComplete(quint32 marker);
+
     bool setScreenRotation(ScreenRotation r, int bpp = 8);
 
     ScreenRotation getScreenRotation();
 
     QRegion doRedraw() override;
 
-    QFbCursor *mCursor;
+    KoboFbCursor *mCursor;
 
     QPlatformCursor *cursor() const override { return mCursor; } // Very important for mouse support
 
-    void mouseMoveChecker();
+    void scheduleCursorUpdate();
+
+    void cursorShapeChanged();
 
     void setFlashing(bool v);
 
@@ -64,11 +97,66 @@ public:
 
     void doSunxiPenRefresh();
 
+    void penDown();
+
+    void setFastInk(const QRect &area, int strokeWidth);
+
+    bool drawFastInk(const QPoint &from, const QPoint &to);
+
+    // An empty region removes the hint registered under name
+    void setWaveformHintRegion(const QString &name, const QRect &region, WaveForm waveform);
+
+    void setPageTurnRefresh(bool enabled, WaveForm waveform, bool flashing);
+
+    // Frames redrawn from now on are reported under name, with redrawstats=
+    void setRedrawWorkload(const QString &name);
+
+    // Called from the input thread on a page turn key, the next refresh uses the page turn mode
+    void armPageTurnRefresh();
+
     void waitForRefresh(bool force = false);
 
+    // Null unless touchlatency is set
+    KoboLatencyTracker *latencyTracker() const { return touchLatency; }
+
+signals:
+    // No refresh is queued anymore, input held back to spare the panel can be delivered
+    void refreshIdle();
+
 private:
+    void initializeVirtualFramebuffer(const QSize &size);
+
     void ditherRegion(const QRect &region);
 
+    bool isSmallRegion(const QRect &region) const;
+
+    void finishRefreshTransaction();
+
+    int waveformFromHint(const QVariant &hint) const;
+
+    // Splits the damage by waveform hint, what no hint covers keeps the global waveform policy
+    void classifyDamage(const QRegion &touched, QRegion &unhinted, QMap<int, QRect> &hinted);
+
+    void queueRefresh(const QRect &region);
+
+    void flushPendingRefresh();
+
+    bool updateCursor();
+
+    void cursorRefreshDone();
+
+    void showStandbyCursor();
+
+    void loadStandbySprite();
+
+    void restoreCursorBackground();
+
+    void placeCursor(const KoboFbCursor::Sprite &sprite, const QPoint &pos);
+
+    void saveCursorBackground(const QRect &area);
+
+    void compositeCursor(const QRect &area);
+
     KoboDeviceDescriptor *koboDevice;
 
     QStringList mArgs;
@@ -91,6 +179,12 @@ private:
 
     FBInkConfig fbink_cfg;
 
+    KoboRefreshArbiter *mArbiter = nullptr;
+
+    // virtualfb: no framebuffer device, the screen lives in memory and refreshes are simulated
+    KoboVirtualEpdc *virtualEpdc = nullptr;
+    QSize virtualSize;  // unrotated
+
     bool useHardwareDithering;
     bool useSoftwareDithering;
 
@@ -101,26 +195,76 @@ private:
     int originalRotation;
     int originalBpp;
 
-    bool renderCursor = false;
     bool mouse = false;
     bool motionDebug = false;
-    QTimer* mouseTimer;
+    QTimer* cursorRefreshTimer = nullptr;
+    QTimer* cursorIdleTimer = nullptr;
     QPoint previousPosition;
-    bool changedTime = false;
-    int slowRefresh = 300; // This speed determines how fast will it switch to fastRefresh when the mouse starts moving
-    int fastRefresh = 125; // This speeds determines how often cursor is updated when moving
-    int cyclesUntilSlow = 1; // fastRefresh * cyclesUntilSlow time & this also cleans the previous cursor if it stops
-    int countCycles = 0;
-    QVector<QRect> savedCursorRects;
-    QRect dirtyRect;
-
-    QImage cleanStopFragment;
+    bool cursorMoving = false;
+    bool cursorUpdatePending = false;
+    bool cursorShapeDirty = false;
+    int fastRefresh = 125; // Minimum time between two cursor steps, moves in between are merged into the next one
+    int standbyDelay = 300; // Time without motion after which the standby cursor is drawn and the previous one cleaned
+    // Framebuffer pixels under the drawn cursor, allocated once with the maximum sprite size
+    QImage cursorSaveUnder;
+    QRect cursorRect;
+    QPoint cursorOrigin;
+    KoboFbCursor::Sprite cursorSprite;
+
     QFile standbyCursorFile{"standby_cursor.png"};
-    QImage* standbyCursor;
-    QRect stopRect = QRect{0, 0, 0, 0};
+    KoboFbCursor::Sprite standbySprite;
 
     bool flashingEnabled = true;
     bool nightMode = false;
+
+    // Damage collected during the coalescing window is submitted as one refresh
+    int refreshCoalesceMs = 0;
+    QTimer *refreshCoalesceTimer = nullptr;
+    QRect pendingRefreshRect;
+
+    // Fast ink is drawn from the touch thread, the area is set from the GUI thread. The lock also
+    // keeps the ink and the blit of doRedraw from writing the framebuffer at the same time
+    QMutex fastInkMutex;
+    QRect fastInkArea;
+    int fastInkWidth = 3;
+
+    // Damage held back by an open refresh transaction, committed anyway after the timeout
+    int transactionDepth = 0;
+    bool transactionOpen = false;
+    WaveForm transactionWaveform = WaveForm_AUTO;
+    QRegion transactionUnhinted;
+    QMap<int, QRect> transactionHinted;
+    QTimer *transactionTimer = nullptr;
+    int transactionTimeout = 1000;
+
+    struct StagedSurface
+    {
+        QImage composed;  // as Qt would compose it
+        QImage pixels;    // as it goes into the framebuffer
+        QPoint position;
+    };
+    QMap<QString, StagedSurface> stagedSurfaces;
+
+    struct WaveformHint
+    {
+        QRect region;
+        WFM_MODE_INDEX_T waveform;
+    };
+    QMap<QString, WaveformHint> waveformHintRegions;
+
+    bool pageTurnRefresh = false;
+    WFM_MODE_INDEX_T pageTurnWaveform = WFM_GC16;
+    bool pageTurnFlashing = true;
+    // Set by the key thread, the page the key asks for is repainted well within this. A refresh
+    // after the deadline belongs to something else and gets the normal waveform
+    static const int pageTurnArmMs = 150;
+    QAtomicInteger<qint64> pageTurnDeadline;  // msecs of QDeadlineTimer, 0 when not armed
+
+    KoboRedrawStats *redrawStats = nullptr;
+    KoboLatencyTracker *touchLatency = nullptr;
+
+    // Bumped from the GUI thread and by fast ink on the input thread
+    QAtomicInteger<quint32> frameSequence;
 };
 
 #endif  // QKOBOFBSCREEN_H
@@ -0,0 +1,100 @@
+#include "koboinputthread.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <QDebug>
+#include <QSocketNotifier>
+
+KoboInputThread::KoboInputThread(int realtimePriority, QObject *parent)
+    : QDaemonThread(parent), epollFd(epoll_create1(EPOLL_CLOEXEC)), realtimePriority(realtimePriority)
+{
+    if (epollFd < 0)
+        qDebug() << "Failed to create the input epoll fd:" << strerror(errno);
+
+    // Queued calls to the context run on this thread as soon as its event loop is up
+    context = new QObject;
+    context->moveToThread(this);
+
+    start();
+}
+
+KoboInputThread::~KoboInputThread()
+{
+    quit();
+    wait();
+
+    delete context;
+    if (epollFd >= 0)
+        close(epollFd);
+}
+
+void KoboInputThread::run()
+{
+    if (realtimePriority > 0)
+    {
+        sched_param param = {};
+        param.sched_priority = realtimePriority;
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+            qDebug() << "Failed to give the input thread realtime priority" << realtimePriority;
+    }
+
+    notifier = new QSocketNotifier(epollFd, QSocketNotifier::Read);
+    connect(notifier, &QSocketNotifier::activated, notifier, [this] { dispatch(); });
+
+    exec();
+
+    delete notifier;
+    notifier = nullptr;
+}
+
+void KoboInputThread::addFd(int fd, std::function<void()> onReadable)
+{
+    QMutexLocker locker(&fdMutex);
+    readers.insert(fd, std::move(onReadable));
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+        qDebug() << "Failed to watch input fd" << fd << strerror(errno);
+}
+
+void KoboInputThread::removeFd(int fd)
+{
+    QMutexLocker locker(&fdMutex);
+    readers.remove(fd);
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void KoboInputThread::runInThread(std::function<void()> f)
+{
+    if (QThread::currentThread() == this)
+        f();
+    else
+        QMetaObject::invokeMethod(context, f, Qt::BlockingQueuedConnection);
+}
+
+void KoboInputThread::dispatch()
+{
+    epoll_event events[16];
+    const int count = epoll_wait(epollFd, events, 16, 0);
+
+    for (int i = 0; i < count; ++i)
+    {
+        // Readers are only removed on this thread or with it blocked in runInThread,
+        // the copy just keeps the lock short
+        std::function<void()> reader;
+        {
+            QMutexLocker locker(&fdMutex);
+            reader = readers.value(events[i].data.fd);
+        }
+        if (reader)
+            reader();
+    }
+}
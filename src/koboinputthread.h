@@ -0,0 +1,46 @@
+#ifndef KOBOINPUTTHREAD_H
+#define KOBOINPUTTHREAD_H
+
+#include <QtCore/private/qthread_p.h>
+
+#include <QHash>
+#include <QMutex>
+#include <functional>
+
+class QSocketNotifier;
+
+// One thread for all evdev devices: their fds are multiplexed through a single epoll fd, which is
+// the only thing the thread's event loop watches. Devices come and go without threads being created.
+class KoboInputThread : public QDaemonThread
+{
+    Q_OBJECT
+public:
+    // A realtime priority > 0 runs the thread with SCHED_FIFO
+    explicit KoboInputThread(int realtimePriority = 0, QObject *parent = nullptr);
+    ~KoboInputThread();
+
+    // Called on this thread whenever fd is readable, until it is removed again
+    void addFd(int fd, std::function<void()> onReadable);
+
+    void removeFd(int fd);
+
+    // Runs f on this thread and waits for it, objects living on this thread are created that way
+    void runInThread(std::function<void()> f);
+
+protected:
+    void run() override;
+
+private:
+    void dispatch();
+
+    int epollFd;
+    int realtimePriority;
+
+    QObject *context;
+    QSocketNotifier *notifier = nullptr;
+
+    QMutex fdMutex;
+    QHash<int, std::function<void()>> readers;
+};
+
+#endif  // KOBOINPUTTHREAD_H
@@ -0,0 +1,117 @@
+#include "kobokeyhandler.h"
+
+#include <QtGui/private/qwindowsysteminterface_p.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#include <QDebug>
+#include <QFile>
+
+#include "einkenums.h"
+#include "kobofbscreen.h"
+#include "koboinputthread.h"
+
+KoboKeyHandler::KoboKeyHandler(const QString &device, KoboInputThread *inputThread, KoboFbScreen *screen,
+                               bool debug)
+    : inputThread(inputThread), screen(screen), debug(debug)
+{
+    fd = open(device.toLocal8Bit().constData(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+    {
+        qDebug() << "Cannot open key device" << device;
+        return;
+    }
+
+    // Same clock as the one the event timestamps are compared against
+    int clock = CLOCK_MONOTONIC;
+    ioctl(fd, EVIOCSCLOCKID, &clock);
+
+    inputThread->addFd(fd, [this] { readData(); });
+
+    if (debug)
+        qDebug() << "Reading physical keys from" << device;
+}
+
+KoboKeyHandler::~KoboKeyHandler()
+{
+    if (fd >= 0)
+    {
+        inputThread->removeFd(fd);
+        close(fd);
+    }
+}
+
+QString KoboKeyHandler::defaultDevice()
+{
+    const QString byPath = QStringLiteral("/dev/input/by-path/platform-gpio-keys-event");
+    if (QFile::exists(byPath))
+        return byPath;
+    return QStringLiteral("/dev/input/event0");
+}
+
+void KoboKeyHandler::readData()
+{
+    for (;;)
+    {
+        ssize_t size = read(fd, readBuffer, sizeof(readBuffer));
+        if (size <= 0)
+        {
+            if (size < 0 && errno == EINTR)
+                continue;
+            if (size < 0 && errno == ENODEV)
+            {
+                qDebug() << "Key device disconnected";
+                inputThread->removeFd(fd);
+                close(fd);
+                fd = -1;
+            }
+            return;
+        }
+
+        const int n = size / sizeof(input_event);
+        for (int i = 0; i < n; ++i)
+        {
+            if (readBuffer[i].type == EV_KEY)
+                processKey(readBuffer[i]);
+        }
+    }
+}
+
+void KoboKeyHandler::processKey(const input_event &event)
+{
+    auto it = KoboPhysicalKeyMap.constFind(event.code);
+    if (it == KoboPhysicalKeyMap.constEnd())
+        return;
+
+    const KoboKey key = it.value();
+    const bool pressed = event.value != 0;
+    const bool autoRepeat = event.value == 2;
+
+    if (debug)
+        qDebug() << "Physical key" << event.code << "->" << Qt::hex << key
+                 << (pressed ? "pressed" : "released");
+
+    // Lets the screen get ready for the page before the application has even seen the key
+    if (pressed && !autoRepeat && (key == Key_PageForward || key == Key_PagePackward))
+        screen->armPageTurnRefresh();
+
+    QWindowSystemInterface::handleKeyEvent(nullptr, eventTimestamp(event),
+                                           pressed ? QEvent::KeyPress : QEvent::KeyRelease, key,
+                                           Qt::NoModifier, QString(), autoRepeat);
+}
+
+ulong KoboKeyHandler::eventTimestamp(const input_event &event) const
+{
+    // Qt timestamps count from its own start, move the kernel time over by the age of the event
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const qint64 ageMs = (qint64(now.tv_sec) - event.time.tv_sec) * 1000 +
+                         (qint64(now.tv_nsec) / 1000 - event.time.tv_usec) / 1000;
+
+    const qint64 timestamp = QWindowSystemInterfacePrivate::eventTime.elapsed() - qMax<qint64>(ageMs, 0);
+    return ulong(qMax<qint64>(timestamp, 0));
+}
@@ -0,0 +1,40 @@
+#ifndef KOBOKEYHANDLER_H
+#define KOBOKEYHANDLER_H
+
+#include <linux/input.h>
+
+#include <QString>
+
+class KoboFbScreen;
+class KoboInputThread;
+
+// Reads the gpio-keys device on the input thread and delivers the keys in KoboPhysicalKeyMap as Qt key
+// events, timestamped with the time the kernel saw them rather than the time they were read.
+// Has to be created and deleted on the input thread.
+class KoboKeyHandler
+{
+public:
+    KoboKeyHandler(const QString &device, KoboInputThread *inputThread, KoboFbScreen *screen, bool debug);
+    ~KoboKeyHandler();
+
+    bool isOpen() const { return fd >= 0; }
+
+    // Where the keys are on most Kobos, the by-path link when the kernel provides one
+    static QString defaultDevice();
+
+private:
+    void readData();
+
+    void processKey(const input_event &event);
+
+    ulong eventTimestamp(const input_event &event) const;
+
+    KoboInputThread *inputThread;
+    KoboFbScreen *screen;
+    bool debug;
+
+    int fd = -1;
+    input_event readBuffer[32];
+};
+
+#endif  // KOBOKEYHANDLER_H
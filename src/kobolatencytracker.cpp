@@ -0,0 +1,140 @@
+#include "kobolatencytracker.h"
+
+#include <time.h>
+
+#include <cstring>
+
+#include <QDebug>
+
+namespace
+{
+qint64 clockUs(clockid_t clock)
+{
+    timespec now;
+    clock_gettime(clock, &now);
+    return qint64(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+}  // namespace
+
+KoboLatencyTracker::KoboLatencyTracker(bool log) : log(log)
+{
+}
+
+qint64 KoboLatencyTracker::nowUs()
+{
+    return clockUs(CLOCK_MONOTONIC);
+}
+
+void KoboLatencyTracker::touchReported(double eventTime)
+{
+    // evdev stamps touch events with the realtime clock, move the event over by its age
+    const qint64 now = nowUs();
+    const qint64 ageUs = clockUs(CLOCK_REALTIME) - qint64(eventTime * 1e6);
+
+    // Clock changes and replayed recordings
+    if (ageUs < 0 || ageUs > 5000000)
+        return;
+
+    QMutexLocker locker(&mutex);
+    if (pending.id)
+        return;
+
+    pending.id = nextId++;
+    if (!nextId)
+        nextId = 1;
+    pending.eventUs = now - ageUs;
+    pending.reportedUs = now;
+}
+
+void KoboLatencyTracker::redrawStarted(qint64 startUs)
+{
+    QMutexLocker locker(&mutex);
+
+    // Touches handed to Qt after the redraw started can't be in it
+    if (!pending.id || rendering.id || pending.reportedUs > startUs)
+        return;
+
+    rendering = pending;
+    rendering.redrawUs = startUs;
+    pending = Sample();
+}
+
+bool KoboLatencyTracker::wantsMarker()
+{
+    QMutexLocker locker(&mutex);
+    return rendering.id != 0;
+}
+
+void KoboLatencyTracker::refreshSubmitted(quint32 marker)
+{
+    QMutexLocker locker(&mutex);
+    if (!rendering.id)
+        return;
+
+    rendering.submittedUs = nowUs();
+    rendering.marker = marker;
+    record(LatencyStage_Input, rendering.reportedUs - rendering.eventUs);
+    record(LatencyStage_Application, rendering.redrawUs - rendering.reportedUs);
+    record(LatencyStage_Render, rendering.submittedUs - rendering.redrawUs);
+    record(LatencyStage_TouchToSubmit, rendering.submittedUs - rendering.eventUs);
+
+    if (marker != RefreshMarker_Failed)
+        displaying.append(rendering);
+    else if (log)
+        qDebug() << "Touch latency: touch" << rendering.id << "refresh failed, not followed further";
+
+    // The waiter drops markers it never reports when the screen goes away, don't let them pile up
+    if (displaying.size() > 16)
+        displaying.removeFirst();
+
+    rendering = Sample();
+}
+
+void KoboLatencyTracker::refreshCompleted(quint32 marker)
+{
+    const qint64 now = nowUs();
+    QMutexLocker locker(&mutex);
+
+    // Refreshes deferred by the pen all share RefreshMarker_Deferred and complete together
+    for (int i = displaying.size() - 1; i >= 0; i--)
+    {
+        const Sample &sample = displaying.at(i);
+        if (sample.marker != marker)
+            continue;
+
+        record(LatencyStage_Display, now - sample.submittedUs);
+        record(LatencyStage_TouchToPhoton, now - sample.eventUs);
+
+        if (log)
+            qDebug().nospace() << "Touch latency: touch " << sample.id << " marker " << marker
+                               << ": input " << (sample.reportedUs - sample.eventUs) / 1000.0
+                               << " ms, application " << (sample.redrawUs - sample.reportedUs) / 1000.0
+                               << " ms, render " << (sample.submittedUs - sample.redrawUs) / 1000.0
+                               << " ms, display " << (now - sample.submittedUs) / 1000.0 << " ms, total "
+                               << (now - sample.eventUs) / 1000.0 << " ms";
+
+        displaying.remove(i);
+    }
+}
+
+void KoboLatencyTracker::record(LatencyStage stage, qint64 us)
+{
+    int bucket = 0;
+    for (qint64 limitUs = 1000; bucket < BucketCount - 1 && us >= limitUs; limitUs *= 2)
+        bucket++;
+    counts[stage][bucket]++;
+}
+
+QVector<quint32> KoboLatencyTracker::histogram(LatencyStage stage)
+{
+    QMutexLocker locker(&mutex);
+    if (stage < 0 || stage >= LatencyStage_Count)
+        return QVector<quint32>();
+    return QVector<quint32>(counts[stage], counts[stage] + BucketCount);
+}
+
+void KoboLatencyTracker::reset()
+{
+    QMutexLocker locker(&mutex);
+    memset(counts, 0, sizeof(counts));
+}
@@ -0,0 +1,66 @@
+#ifndef KOBOLATENCYTRACKER_H
+#define KOBOLATENCYTRACKER_H
+
+#include <QMutex>
+#include <QVector>
+
+#include "einkenums.h"
+
+// Follows touch frames to the refresh that shows their result, enabled with touchlatency. The oldest touch
+// no redraw has answered yet gets an id when it is handed to Qt, the next redraw with damage takes it, the
+// refresh sent for that redraw carries it and the completion of the refresh's marker closes it. Every
+// stage lands in a histogram with power of two buckets: bucket i counts latencies under 2^i ms, the last
+// one everything slower.
+class KoboLatencyTracker
+{
+public:
+    explicit KoboLatencyTracker(bool log);
+
+    static const int BucketCount = 13;
+
+    // Input thread. eventTime is the kernel timestamp of the SYN_REPORT, in realtime seconds.
+    void touchReported(double eventTime);
+
+    // GUI thread, for a redraw with damage that started at startUs
+    void redrawStarted(qint64 startUs);
+
+    // Whether a touch waits for the next refresh, which then has to be sent with a marker
+    bool wantsMarker();
+
+    // RefreshMarker_Failed drops the touch, RefreshMarker_Deferred completes with the pen cleanup refresh
+    void refreshSubmitted(quint32 marker);
+
+    // Arbiter's marker waiter
+    void refreshCompleted(quint32 marker);
+
+    QVector<quint32> histogram(LatencyStage stage);
+
+    void reset();
+
+    // CLOCK_MONOTONIC, the clock the stages are measured with
+    static qint64 nowUs();
+
+private:
+    struct Sample
+    {
+        quint32 id = 0;
+        qint64 eventUs = 0;
+        qint64 reportedUs = 0;
+        qint64 redrawUs = 0;
+        qint64 submittedUs = 0;
+        quint32 marker = 0;
+    };
+
+    void record(LatencyStage stage, qint64 us);
+
+    bool log;
+
+    QMutex mutex;
+    quint32 nextId = 1;
+    Sample pending;    // handed to Qt, no redraw yet
+    Sample rendering;  // redrawn, no refresh yet
+    QVector<Sample> displaying;
+    quint32 counts[LatencyStage_Count][BucketCount] = {};
+};
+
+#endif  // KOBOLATENCYTRACKER_H
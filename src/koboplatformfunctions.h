@@ -1,7 +1,9 @@
 #ifndef KOBOPLATFORMFUNCTIONS_H
 #define KOBOPLATFORMFUNCTIONS_H
 
+#include <QImage>
 #include <QRect>
+#include <QRegion>
 #include <QtCore/QByteArray>
 #include <QtGui/QGuiApplication>
 
@@ -131,6 +133,232 @@ public:
             func(region);
     }
 
+    // Pen strokes inside area are drawn straight to the framebuffer by the input thread, with the given
+    // width in pixels, until the application repaints them. An empty area turns it off.
+    typedef void (*setFastInkType)(QRect area, int strokeWidth);
+    static QByteArray setFastInkIdentifier() { return QByteArrayLiteral("setFastInk"); }
+
+    static void setFastInk(QRect area, int strokeWidth)
+    {
+        auto func =
+            reinterpret_cast<setFastInkType>(QGuiApplication::platformFunction(setFastInkIdentifier()));
+        if (func)
+            func(area, strokeWidth);
+    }
+
+    // With physical keys enabled, pressing a page turn key makes the next refresh use waveform and flashing,
+    // before the application got the key and repainted
+    typedef void (*setPageTurnRefreshType)(bool enabled, WaveForm waveform, bool flashing);
+    static QByteArray setPageTurnRefreshIdentifier() { return QByteArrayLiteral("setPageTurnRefresh"); }
+
+    static void setPageTurnRefresh(bool enabled, WaveForm waveform, bool flashing)
+    {
+        auto func = reinterpret_cast<setPageTurnRefreshType>(
+            QGuiApplication::platformFunction(setPageTurnRefreshIdentifier()));
+        if (func)
+            func(enabled, waveform, flashing);
+    }
+
+    // Refreshes region with waveform and RefreshFlag flags, up to four rects as one update each. Returns the
+    // highest update marker sent, for waitForMarker and isMarkerComplete, or a RefreshMarker:
+    // RefreshMarker_Failed when nothing could be sent or region is empty or off screen, which never
+    // completes, and RefreshMarker_Deferred when sunxi pen mode held a flashing refresh back, which
+    // completes once the cleanup refresh after the pen lifts is on screen.
+    typedef quint32 (*submitRefreshType)(QRegion region, WaveForm waveform, int flags);
+    static QByteArray submitRefreshIdentifier() { return QByteArrayLiteral("submitRefresh"); }
+
+    static quint32 submitRefresh(QRegion region, WaveForm waveform, int flags = RefreshFlag_None)
+    {
+        auto func =
+            reinterpret_cast<submitRefreshType>(QGuiApplication::platformFunction(submitRefreshIdentifier()));
+        if (func)
+            return func(region, waveform, flags);
+        return 0;
+    }
+
+    // True once the refresh behind marker is on screen, false if timeoutMs ran out first. -1 waits forever.
+    // RefreshMarker_Failed returns false at once.
+    typedef bool (*waitForMarkerType)(quint32 marker, int timeoutMs);
+    static QByteArray waitForMarkerIdentifier() { return QByteArrayLiteral("waitForMarker"); }
+
+    static bool waitForMarker(quint32 marker, int timeoutMs = -1)
+    {
+        auto func =
+            reinterpret_cast<waitForMarkerType>(QGuiApplication::platformFunction(waitForMarkerIdentifier()));
+        if (func)
+            return func(marker, timeoutMs);
+        return true;
+    }
+
+    typedef bool (*isMarkerCompleteType)(quint32 marker);
+    static QByteArray isMarkerCompleteIdentifier() { return QByteArrayLiteral("isMarkerComplete"); }
+
+    static bool isMarkerComplete(quint32 marker)
+    {
+        auto func = reinterpret_cast<isMarkerCompleteType>(
+            QGuiApplication::platformFunction(isMarkerCompleteIdentifier()));
+        if (func)
+            return func(marker);
+        return true;
+    }
+
+    // Repaints between begin and commit reach the framebuffer but not the panel, the commit sends one refresh
+    // covering all of them. WaveForm_AUTO lets the hints and the refresh modes decide. Transactions nest,
+    // one left open for a second is committed anyway.
+    typedef void (*beginRefreshTransactionType)();
+    static QByteArray beginRefreshTransactionIdentifier()
+    {
+        return QByteArrayLiteral("beginRefreshTransaction");
+    }
+
+    static void beginRefreshTransaction()
+    {
+        auto func = reinterpret_cast<beginRefreshTransactionType>(
+            QGuiApplication::platformFunction(beginRefreshTransactionIdentifier()));
+        if (func)
+            func();
+    }
+
+    typedef void (*commitRefreshTransactionType)(WaveForm waveform);
+    static QByteArray commitRefreshTransactionIdentifier()
+    {
+        return QByteArrayLiteral("commitRefreshTransaction");
+    }
+
+    static void commitRefreshTransaction(WaveForm waveform = WaveForm_AUTO)
+    {
+        auto func = reinterpret_cast<commitRefreshTransactionType>(
+            QGuiApplication::platformFunction(commitRefreshTransactionIdentifier()));
+        if (func)
+            func(waveform);
+    }
+
+    // Repaints inside region are refreshed with waveform, on top of the KoboWaveformHintProperty of the
+    // windows. Registered under name, an empty region removes it.
+    typedef void (*setWaveformHintRegionType)(QString name, QRect region, WaveForm waveform);
+    static QByteArray setWaveformHintRegionIdentifier() { return QByteArrayLiteral("setWaveformHintRegion"); }
+
+    static void setWaveformHintRegion(QString name, QRect region, WaveForm waveform)
+    {
+        auto func = reinterpret_cast<setWaveformHintRegionType>(
+            QGuiApplication::platformFunction(setWaveformHintRegionIdentifier()));
+        if (func)
+            func(name, region, waveform);
+    }
+
+    // Prepares image at position on the screen under name: converted to the framebuffer format and dithered
+    // ahead of time, so commitSurface only copies it and refreshes. A null image drops the surface.
+    typedef bool (*stageSurfaceType)(QString name, QImage image, QPoint position);
+    static QByteArray stageSurfaceIdentifier() { return QByteArrayLiteral("stageSurface"); }
+
+    static bool stageSurface(QString name, QImage image, QPoint position)
+    {
+        auto func =
+            reinterpret_cast<stageSurfaceType>(QGuiApplication::platformFunction(stageSurfaceIdentifier()));
+        if (func)
+            return func(name, image, position);
+        return false;
+    }
+
+    // Shows a staged surface, skipping Qt's composition, and returns the marker of its refresh. The window
+    // contents are updated too so the next repaint keeps it. The surface stays staged until dropped.
+    typedef quint32 (*commitSurfaceType)(QString name, WaveForm waveform, int flags);
+    static QByteArray commitSurfaceIdentifier() { return QByteArrayLiteral("commitSurface"); }
+
+    static quint32 commitSurface(QString name, WaveForm waveform = WaveForm_GC16, int flags = RefreshFlag_None)
+    {
+        auto func =
+            reinterpret_cast<commitSurfaceType>(QGuiApplication::platformFunction(commitSurfaceIdentifier()));
+        if (func)
+            return func(name, waveform, flags);
+        return 0;
+    }
+
+    // A read-only view on one of the screen buffers, no pixels are copied. It stays valid until the screen
+    // rotates. sequence changes with every write to the framebuffer: if getScreenBufferSequence still
+    // returns the same after the view was used, the view was consistent.
+    typedef QImage (*getScreenBufferType)(ScreenBuffer buffer, quint32 *sequence);
+    static QByteArray getScreenBufferIdentifier() { return QByteArrayLiteral("getScreenBuffer"); }
+
+    static QImage getScreenBuffer(ScreenBuffer buffer, quint32 *sequence = nullptr)
+    {
+        auto func = reinterpret_cast<getScreenBufferType>(
+            QGuiApplication::platformFunction(getScreenBufferIdentifier()));
+        if (func)
+            return func(buffer, sequence);
+        return QImage();
+    }
+
+    typedef quint32 (*getScreenBufferSequenceType)();
+    static QByteArray getScreenBufferSequenceIdentifier()
+    {
+        return QByteArrayLiteral("getScreenBufferSequence");
+    }
+
+    static quint32 getScreenBufferSequence()
+    {
+        auto func = reinterpret_cast<getScreenBufferSequenceType>(
+            QGuiApplication::platformFunction(getScreenBufferSequenceIdentifier()));
+        if (func)
+            return func();
+        return 0;
+    }
+
+    // Names the workload the following frames belong to in the redrawstats= report, so an application
+    // driving scripted scenarios (page turn, scrolling, typing...) gets a summary for each
+    typedef void (*setRedrawWorkloadType)(QString name);
+    static QByteArray setRedrawWorkloadIdentifier() { return QByteArrayLiteral("setRedrawWorkload"); }
+
+    static void setRedrawWorkload(QString name)
+    {
+        auto func = reinterpret_cast<setRedrawWorkloadType>(
+            QGuiApplication::platformFunction(setRedrawWorkloadIdentifier()));
+        if (func)
+            func(name);
+    }
+
+    // Touch to refresh latency of one stage, with touchlatency. Bucket i counts latencies under 2^i ms, the
+    // last bucket everything slower. Empty when latency isn't tracked.
+    typedef QVector<quint32> (*getLatencyHistogramType)(LatencyStage stage);
+    static QByteArray getLatencyHistogramIdentifier() { return QByteArrayLiteral("getLatencyHistogram"); }
+
+    static QVector<quint32> getLatencyHistogram(LatencyStage stage)
+    {
+        auto func = reinterpret_cast<getLatencyHistogramType>(
+            QGuiApplication::platformFunction(getLatencyHistogramIdentifier()));
+        if (func)
+            return func(stage);
+        return QVector<quint32>();
+    }
+
+    typedef void (*resetLatencyHistogramsType)();
+    static QByteArray resetLatencyHistogramsIdentifier()
+    {
+        return QByteArrayLiteral("resetLatencyHistograms");
+    }
+
+    static void resetLatencyHistograms()
+    {
+        auto func = reinterpret_cast<resetLatencyHistogramsType>(
+            QGuiApplication::platformFunction(resetLatencyHistogramsIdentifier()));
+        if (func)
+            func();
+    }
+
+    // Frames the touchscreen driver dropped because its queue overflowed before the plugin read it. The
+    // touch state is queried again after each, so a growing count means lag rather than lost contacts.
+    typedef quint32 (*getTouchDroppedFramesType)();
+    static QByteArray getTouchDroppedFramesIdentifier() { return QByteArrayLiteral("getTouchDroppedFrames"); }
+
+    static quint32 getTouchDroppedFrames()
+    {
+        auto func = reinterpret_cast<getTouchDroppedFramesType>(
+            QGuiApplication::platformFunction(getTouchDroppedFramesIdentifier()));
+        if (func)
+            return func();
+        return 0;
+    }
+
     typedef KoboDeviceDescriptor (*getKoboDeviceDescriptorType)();
     static QByteArray getKoboDeviceDescriptorIdentifier()
     {
@@ -8,6 +8,8 @@
 #include <QtServiceSupport/private/qgenericunixservices_p.h>
 #include <qpa/qplatforminputcontextfactory_p.h>
 
+#include <QTimer>
+
 #if QT_CONFIG(libinput)
 #include <QtInputSupport/private/qlibinputhandler_p.h>
 #endif
@@ -17,6 +19,10 @@
 #include <QtInputSupport/private/qevdevmousemanager_p.h>
 #endif
 
+#include "koboinputthread.h"
+#include "kobokeyhandler.h"
+#include "kobolatencytracker.h"
+#include "kobostartuptrace.h"
 #include "qevdevtouchmanager_p.h"
 
 KoboPlatformIntegration::KoboPlatformIntegration(const QStringList &paramList)
@@ -27,7 +33,20 @@ KoboPlatformIntegration::KoboPlatformIntegration(const QStringList &paramList)
       m_services(new QGenericUnixServices),
       debug(false)
 {
-    koboDevice = determineDevice();
+    bool virtualDevice = false;
+    for (const QString &arg : paramList)
+    {
+        if (arg.contains("debug"))
+            debug = true;
+        if (arg.startsWith("virtualfb"))
+            virtualDevice = true;
+        if (arg.startsWith("startuptrace="))
+            KoboStartupTrace::enable(arg.section('=', 1, 1));
+    }
+
+    KoboStartupTrace::Phase detection("determineDevice");
+    koboDevice = determineDevice(debug, virtualDevice);
+    detection.finish();
 
     if (!m_primaryScreen)
         m_primaryScreen = new KoboFbScreen(paramList, &koboDevice);
@@ -35,19 +54,32 @@ KoboPlatformIntegration::KoboPlatformIntegration(const QStringList &paramList)
 
 KoboPlatformIntegration::~KoboPlatformIntegration()
 {
+    if (m_inputThread)
+    {
+        delete m_touchManager;
+        m_inputThread->runInThread([this] { delete m_keyHandler; });
+        delete m_inputThread;
+    }
+
     QWindowSystemInterface::handleScreenRemoved(m_primaryScreen);
 }
 
 void KoboPlatformIntegration::initialize()
 {
+    KoboStartupTrace::Phase screenPhase("KoboFbScreen::initialize");
     if (m_primaryScreen->initialize())
         QWindowSystemInterface::handleScreenAdded(m_primaryScreen);
     else
         qDebug("kobofb: Failed to initialize screen");
+    screenPhase.finish();
 
+    KoboStartupTrace::Phase inputContextPhase("input context");
     m_inputContext = QPlatformInputContextFactory::create();
+    inputContextPhase.finish();
 
+    KoboStartupTrace::Phase inputPhase("createInputHandlers");
     createInputHandlers();
+    inputPhase.finish();
 
     qDebug("Platform plugin: Finished initialization.");
     qDebug() << "git hash commit:" << GIT_COMMIT_HASH << "git user:" << GIT_USER << "compilation time:" << COMP_TIME;
@@ -113,8 +145,12 @@ void KoboPlatformIntegration::createInputHandlers()
     int touchRangeX = 0;
     int touchRangeY = 0;
     bool legacytouchhandler = false;
+    QString touchHandlerArgs;
     bool keyboard = false;
     bool mouse = false;
+    bool physicalKeys = false;
+    QString keyDevice;
+    int inputRealtimePriority = 0;
 
     auto screenrot = m_primaryScreen->getScreenRotation();
 
@@ -137,6 +173,15 @@ void KoboPlatformIntegration::createInputHandlers()
                 qDebug() << "Mouse support enabled";
             mouse = true;
         }
+        if (arg.startsWith("physicalkeys"))
+        {
+            physicalKeys = true;
+            keyDevice = arg.section('=', 1, 1);
+        }
+        if (arg.startsWith("inputrt="))
+        {
+            inputRealtimePriority = arg.section('=', 1, 1).toInt();
+        }
         if (arg.contains(touchSwapXYRx, &match) && match.captured(1).toInt() > 0)
         {
             koboDevice.touchscreenSettings.swapXY = true;
@@ -161,6 +206,11 @@ void KoboPlatformIntegration::createInputHandlers()
         {
             manualRangeFlip = true;
         }
+        if (arg.startsWith("touchrecord=") || arg.startsWith("touchreplay=") ||
+            arg.startsWith("touchdump=") || arg.startsWith("touchcoalesce="))
+        {
+            touchHandlerArgs += ":" + arg;
+        }
 
         if (koboDevice.mark < 7)
         {
@@ -201,13 +251,40 @@ void KoboPlatformIntegration::createInputHandlers()
     evdevTouchArgs += QString(":screenheight=%1").arg(koboDevice.height);
 
     evdevTouchArgs += QString(":screenrotation=%1").arg(screenrot * 90);
+    evdevTouchArgs += touchHandlerArgs;
+
+    m_inputThread = new KoboInputThread(inputRealtimePriority);
+    m_touchManager =
+        new QEvdevTouchManager("EvdevTouch", evdevTouchArgs, m_inputThread, this, m_primaryScreen);
+
+    if (physicalKeys)
+    {
+        if (keyDevice.isEmpty())
+            keyDevice = KoboKeyHandler::defaultDevice();
+        m_inputThread->runInThread([this, keyDevice] {
+            m_keyHandler = new KoboKeyHandler(keyDevice, m_inputThread, m_primaryScreen, debug);
+        });
+    }
 
-    new QEvdevTouchManager("EvdevTouch", evdevTouchArgs, this, m_primaryScreen);
     if (debug)
         qDebug() << "device:" << koboDevice.modelName << koboDevice.modelNumber << '\n'
                  << "screen:" << koboDevice.width << koboDevice.height << "dpi:" << koboDevice.dpi
                  << "rotation:" << screenrot;
 
+    // Keyboard, mouse and libinput aren't needed for the first frame, they come up with the event loop.
+    // Deferred rather than lazy: the first key press or mouse move is what would tell they are needed, and
+    // it can only be seen with the handlers already open.
+    QTimer::singleShot(0, this, [this, keyboard, mouse] {
+        KoboStartupTrace::Phase phase("peripheral input (deferred)");
+        createPeripheralInputHandlers(keyboard, mouse);
+        phase.finish();
+
+        KoboStartupTrace::write();
+    });
+}
+
+void KoboPlatformIntegration::createPeripheralInputHandlers(bool keyboard, bool mouse)
+{
     // A bit of inspiration: https://github.com/librereader/qpa-einkfb
     if (keyboard == true or mouse == true)
     {
@@ -299,6 +376,38 @@ QFunctionPointer KoboPlatformIntegration::platformFunction(const QByteArray &fun
         return QFunctionPointer(enableDitheringStatic);
     else if (function == KoboPlatformFunctions::doManualRefreshIdentifier())
         return QFunctionPointer(doManualRefreshStatic);
+    else if (function == KoboPlatformFunctions::setFastInkIdentifier())
+        return QFunctionPointer(setFastInkStatic);
+    else if (function == KoboPlatformFunctions::setPageTurnRefreshIdentifier())
+        return QFunctionPointer(setPageTurnRefreshStatic);
+    else if (function == KoboPlatformFunctions::submitRefreshIdentifier())
+        return QFunctionPointer(submitRefreshStatic);
+    else if (function == KoboPlatformFunctions::waitForMarkerIdentifier())
+        return QFunctionPointer(waitForMarkerStatic);
+    else if (function == KoboPlatformFunctions::isMarkerCompleteIdentifier())
+        return QFunctionPointer(isMarkerCompleteStatic);
+    else if (function == KoboPlatformFunctions::setWaveformHintRegionIdentifier())
+        return QFunctionPointer(setWaveformHintRegionStatic);
+    else if (function == KoboPlatformFunctions::beginRefreshTransactionIdentifier())
+        return QFunctionPointer(beginRefreshTransactionStatic);
+    else if (function == KoboPlatformFunctions::commitRefreshTransactionIdentifier())
+        return QFunctionPointer(commitRefreshTransactionStatic);
+    else if (function == KoboPlatformFunctions::stageSurfaceIdentifier())
+        return QFunctionPointer(stageSurfaceStatic);
+    else if (function == KoboPlatformFunctions::commitSurfaceIdentifier())
+        return QFunctionPointer(commitSurfaceStatic);
+    else if (function == KoboPlatformFunctions::getScreenBufferIdentifier())
+        return QFunctionPointer(getScreenBufferStatic);
+    else if (function == KoboPlatformFunctions::getScreenBufferSequenceIdentifier())
+        return QFunctionPointer(getScreenBufferSequenceStatic);
+    else if (function == KoboPlatformFunctions::setRedrawWorkloadIdentifier())
+        return QFunctionPointer(setRedrawWorkloadStatic);
+    else if (function == KoboPlatformFunctions::getLatencyHistogramIdentifier())
+        return QFunctionPointer(getLatencyHistogramStatic);
+    else if (function == KoboPlatformFunctions::resetLatencyHistogramsIdentifier())
+        return QFunctionPointer(resetLatencyHistogramsStatic);
+    else if (function == KoboPlatformFunctions::getTouchDroppedFramesIdentifier())
+        return QFunctionPointer(getTouchDroppedFramesStatic);
     else if (function == KoboPlatformFunctions::getKoboDeviceDescriptorIdentifier())
         return QFunctionPointer(getKoboDeviceDescriptorStatic);
     return 0;
@@ -367,6 +476,120 @@ void KoboPlatformIntegration::doManualRefreshStatic(QRect region)
     self->m_primaryScreen->doManualRefresh(region);
 }
 
+void KoboPlatformIntegration::setFastInkStatic(QRect area, int strokeWidth)
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    self->m_primaryScreen->setFastInk(area, strokeWidth);
+}
+
+void KoboPlatformIntegration::setPageTurnRefreshStatic(bool enabled, WaveForm waveform, bool flashing)
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    self->m_primaryScreen->setPageTurnRefresh(enabled, waveform, flashing);
+}
+
+quint32 KoboPlatformIntegration::submitRefreshStatic(QRegion region, WaveForm waveform, int flags)
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    return self->m_primaryScreen->submitRefresh(region, waveform, flags);
+}
+
+bool KoboPlatformIntegration::waitForMarkerStatic(quint32 marker, int timeoutMs)
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    return self->m_primaryScreen->waitForMarker(marker, timeoutMs);
+}
+
+bool KoboPlatformIntegration::isMarkerCompleteStatic(quint32 marker)
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    return self->m_primaryScreen->isMarkerComplete(marker);
+}
+
+void KoboPlatformIntegration::setWaveformHintRegionStatic(QString name, QRect region, WaveForm waveform)
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    self->m_primaryScreen->setWaveformHintRegion(name, region, waveform);
+}
+
+void KoboPlatformIntegration::beginRefreshTransactionStatic()
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    self->m_primaryScreen->beginRefreshTransaction();
+}
+
+void KoboPlatformIntegration::commitRefreshTransactionStatic(WaveForm waveform)
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    self->m_primaryScreen->commitRefreshTransaction(waveform);
+}
+
+bool KoboPlatformIntegration::stageSurfaceStatic(QString name, QImage image, QPoint position)
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    return self->m_primaryScreen->stageSurface(name, image, position);
+}
+
+quint32 KoboPlatformIntegration::commitSurfaceStatic(QString name, WaveForm waveform, int flags)
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    return self->m_primaryScreen->commitSurface(name, waveform, flags);
+}
+
+QImage KoboPlatformIntegration::getScreenBufferStatic(ScreenBuffer buffer, quint32 *sequence)
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    return self->m_primaryScreen->screenBuffer(buffer, sequence);
+}
+
+quint32 KoboPlatformIntegration::getScreenBufferSequenceStatic()
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    return self->m_primaryScreen->screenBufferSequence();
+}
+
+void KoboPlatformIntegration::setRedrawWorkloadStatic(QString name)
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    self->m_primaryScreen->setRedrawWorkload(name);
+}
+
+QVector<quint32> KoboPlatformIntegration::getLatencyHistogramStatic(LatencyStage stage)
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    KoboLatencyTracker *tracker = self->m_primaryScreen->latencyTracker();
+    return tracker ? tracker->histogram(stage) : QVector<quint32>();
+}
+
+void KoboPlatformIntegration::resetLatencyHistogramsStatic()
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    if (KoboLatencyTracker *tracker = self->m_primaryScreen->latencyTracker())
+        tracker->reset();
+}
+
+quint32 KoboPlatformIntegration::getTouchDroppedFramesStatic()
+{
+    KoboPlatformIntegration *self =
+        static_cast<KoboPlatformIntegration *>(QGuiApplicationPrivate::platformIntegration());
+    return self->m_touchManager ? self->m_touchManager->droppedFrameCount() : 0;
+}
+
 KoboDeviceDescriptor KoboPlatformIntegration::getKoboDeviceDescriptorStatic()
 {
     KoboPlatformIntegration *self =
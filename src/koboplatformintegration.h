@@ -11,8 +11,11 @@
 #include "koboplatformfunctions.h"
 
 class QAbstractEventDispatcher;
+class QEvdevTouchManager;
 class QFbVtHandler;
 class QPlatformCursor;
+class KoboInputThread;
+class KoboKeyHandler;
 
 class KoboPlatformIntegration : public QPlatformIntegration, public QPlatformNativeInterface
 {
@@ -42,6 +45,7 @@ public:
 
 private:
     void createInputHandlers();
+    void createPeripheralInputHandlers(bool keyboard, bool mouse);
     static void setFullScreenRefreshModeStatic(WaveForm waveform);
     static void setPartialScreenRefreshModeStatic(WaveForm waveform);
     static void setFastScreenRefreshModeStatic(WaveForm waveform);
@@ -51,6 +55,22 @@ private:
     static void clearScreenStatic(bool waitForCompleted);
     static void enableDitheringStatic(bool softwareDithering, bool hardwareDithering);
     static void doManualRefreshStatic(QRect region);
+    static void setFastInkStatic(QRect area, int strokeWidth);
+    static void setPageTurnRefreshStatic(bool enabled, WaveForm waveform, bool flashing);
+    static quint32 submitRefreshStatic(QRegion region, WaveForm waveform, int flags);
+    static bool waitForMarkerStatic(quint32 marker, int timeoutMs);
+    static bool isMarkerCompleteStatic(quint32 marker);
+    static void setWaveformHintRegionStatic(QString name, QRect region, WaveForm waveform);
+    static void beginRefreshTransactionStatic();
+    static void commitRefreshTransactionStatic(WaveForm waveform);
+    static bool stageSurfaceStatic(QString name, QImage image, QPoint position);
+    static quint32 commitSurfaceStatic(QString name, WaveForm waveform, int flags);
+    static QImage getScreenBufferStatic(ScreenBuffer buffer, quint32 *sequence);
+    static quint32 getScreenBufferSequenceStatic();
+    static void setRedrawWorkloadStatic(QString name);
+    static QVector<quint32> getLatencyHistogramStatic(LatencyStage stage);
+    static void resetLatencyHistogramsStatic();
+    static quint32 getTouchDroppedFramesStatic();
     static KoboDeviceDescriptor getKoboDeviceDescriptorStatic();
 
     KoboDeviceDescriptor koboDevice;
@@ -61,6 +81,11 @@ private:
     QScopedPointer<QPlatformFontDatabase> m_fontDb;
     QScopedPointer<QPlatformServices> m_services;
 
+    // Reads the touchscreen and the physical keys, stopped only after both are gone
+    KoboInputThread *m_inputThread = nullptr;
+    QEvdevTouchManager *m_touchManager = nullptr;
+    KoboKeyHandler *m_keyHandler = nullptr;
+
     bool debug = false; // Default
 };
 
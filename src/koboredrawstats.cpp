@@ -0,0 +1,195 @@
+#include "koboredrawstats.h"
+
+#include <QDebug>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+
+#include "fbink.h"
+
+namespace
+{
+QString waveformName(int waveform, bool flashing)
+{
+    QString name;
+    switch (waveform)
+    {
+        case WFM_AUTO:
+            name = QStringLiteral("AUTO");
+            break;
+        case WFM_DU:
+            name = QStringLiteral("DU");
+            break;
+        case WFM_GC16:
+            name = QStringLiteral("GC16");
+            break;
+        case WFM_GC4:
+            name = QStringLiteral("GC4");
+            break;
+        case WFM_A2:
+            name = QStringLiteral("A2");
+            break;
+        case WFM_GL16:
+            name = QStringLiteral("GL16");
+            break;
+        case WFM_REAGL:
+            name = QStringLiteral("REAGL");
+            break;
+        case WFM_REAGLD:
+            name = QStringLiteral("REAGLD");
+            break;
+        default:
+            name = QString::number(waveform);
+            break;
+    }
+    return flashing ? name + QStringLiteral(" flashing") : name;
+}
+
+QJsonObject distribution(QVector<qint64> values)
+{
+    if (values.isEmpty())
+        return QJsonObject();
+
+    std::sort(values.begin(), values.end());
+    qint64 sum = 0;
+    for (qint64 value : qAsConst(values))
+        sum += value;
+
+    auto percentile = [&values](int p) { return values[(values.size() - 1) * p / 100]; };
+    return QJsonObject{{"mean", double(sum) / values.size()},
+                       {"p50", percentile(50)},
+                       {"p95", percentile(95)},
+                       {"max", values.last()}};
+}
+}  // namespace
+
+KoboRedrawStats::KoboRedrawStats(const QString &path) : file(path)
+{
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        qDebug() << "Cannot write redraw statistics to" << path;
+    phaseTimer.start();
+}
+
+KoboRedrawStats::~KoboRedrawStats()
+{
+    writeSummary();
+}
+
+void KoboRedrawStats::setWorkload(const QString &name)
+{
+    writeSummary();
+    workload = name;
+}
+
+void KoboRedrawStats::beginFrame()
+{
+    frame = Frame();
+    inFrame = true;
+    painted = false;
+    phaseStartUs = phaseTimer.nsecsElapsed() / 1000;
+}
+
+void KoboRedrawStats::composed()
+{
+    const qint64 now = phaseTimer.nsecsElapsed() / 1000;
+    frame.composeUs = now - phaseStartUs;
+    phaseStartUs = now;
+}
+
+void KoboRedrawStats::dithered()
+{
+    const qint64 now = phaseTimer.nsecsElapsed() / 1000;
+    frame.ditherUs = now - phaseStartUs;
+    phaseStartUs = now;
+}
+
+void KoboRedrawStats::blitted()
+{
+    const qint64 now = phaseTimer.nsecsElapsed() / 1000;
+    frame.blitUs = now - phaseStartUs;
+    phaseStartUs = now;
+    painted = true;
+}
+
+void KoboRedrawStats::endFrame()
+{
+    if (!inFrame)
+        return;
+    inFrame = false;
+
+    // Nothing was damaged, not a frame
+    if (!painted)
+        return;
+
+    frames.append(frame);
+    write(QJsonObject{{"type", "frame"},
+                      {"workload", workload},
+                      {"frame", frameNumber++},
+                      {"composeUs", frame.composeUs},
+                      {"ditherUs", frame.ditherUs},
+                      {"blitUs", frame.blitUs},
+                      {"submitUs", frame.submitUs},
+                      {"refreshes", frame.refreshes},
+                      {"refreshArea", frame.refreshArea}});
+}
+
+void KoboRedrawStats::addRefresh(const QRect &region, int waveform, bool flashing, qint64 submitUs)
+{
+    const qint64 area = qint64(region.width()) * region.height();
+    if (inFrame)
+    {
+        frame.submitUs += submitUs;
+        frame.refreshes++;
+        frame.refreshArea += area;
+    }
+
+    refreshes++;
+    refreshArea += area;
+    waveformMix[waveformName(waveform, flashing)]++;
+}
+
+void KoboRedrawStats::writeSummary()
+{
+    if (frames.isEmpty() && refreshes == 0)
+        return;
+
+    QVector<qint64> compose, dither, blit, submit;
+    for (const Frame &f : qAsConst(frames))
+    {
+        compose.append(f.composeUs);
+        dither.append(f.ditherUs);
+        blit.append(f.blitUs);
+        submit.append(f.submitUs);
+    }
+
+    QJsonObject mix;
+    for (auto it = waveformMix.constBegin(); it != waveformMix.constEnd(); ++it)
+        mix.insert(it.key(), it.value());
+
+    write(QJsonObject{{"type", "summary"},
+                      {"workload", workload},
+                      {"commit", GIT_COMMIT_HASH},
+                      {"frames", frames.size()},
+                      {"composeUs", distribution(compose)},
+                      {"ditherUs", distribution(dither)},
+                      {"blitUs", distribution(blit)},
+                      {"submitUs", distribution(submit)},
+                      {"refreshes", refreshes},
+                      {"refreshArea", refreshArea},
+                      {"waveforms", mix}});
+
+    frames.clear();
+    frameNumber = 0;
+    refreshes = 0;
+    refreshArea = 0;
+    waveformMix.clear();
+    file.flush();
+}
+
+void KoboRedrawStats::write(const QJsonObject &object)
+{
+    if (!file.isOpen())
+        return;
+    file.write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    file.write("\n");
+}
@@ -0,0 +1,72 @@
+#ifndef KOBOREDRAWSTATS_H
+#define KOBOREDRAWSTATS_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMap>
+#include <QRect>
+#include <QVector>
+
+class QJsonObject;
+
+// Records what every doRedraw costs, enabled with redrawstats=<file>. Each frame is written as a line of
+// JSON with its compose, dither, blit and refresh submit times and the refreshes it sent. Frames are
+// grouped into workloads named by the application through KoboPlatformFunctions::setRedrawWorkload,
+// each closed by a summary line with percentiles, refresh count and area and the waveform mix, tagged
+// with the commit the plugin was built from so reports of two builds can be compared.
+// Used from the GUI thread only.
+class KoboRedrawStats
+{
+public:
+    explicit KoboRedrawStats(const QString &path);
+    ~KoboRedrawStats();
+
+    bool isOpen() const { return file.isOpen(); }
+
+    // Writes the summary of the current workload and starts the next one
+    void setWorkload(const QString &name);
+
+    void beginFrame();
+
+    void composed();
+
+    void dithered();
+
+    void blitted();
+
+    void endFrame();
+
+    // A refresh sent to the arbiter, inside a frame or later by the coalescing timer or a transaction
+    void addRefresh(const QRect &region, int waveform, bool flashing, qint64 submitUs);
+
+private:
+    struct Frame
+    {
+        qint64 composeUs = 0;
+        qint64 ditherUs = 0;
+        qint64 blitUs = 0;
+        qint64 submitUs = 0;
+        int refreshes = 0;
+        qint64 refreshArea = 0;
+    };
+
+    void writeSummary();
+
+    void write(const QJsonObject &object);
+
+    QFile file;
+    QElapsedTimer phaseTimer;
+    qint64 phaseStartUs = 0;
+    bool inFrame = false;
+    bool painted = false;
+    Frame frame;
+
+    QString workload;
+    int frameNumber = 0;
+    QVector<Frame> frames;
+    int refreshes = 0;
+    qint64 refreshArea = 0;
+    QMap<QString, int> waveformMix;
+};
+
+#endif  // KOBOREDRAWSTATS_H
@@ -0,0 +1,336 @@
+#include "koborefresharbiter.h"
+
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#include <QDeadlineTimer>
+#include <QDebug>
+#include <QThread>
+#include <QTimer>
+
+#include "kobovirtualepdc.h"
+
+KoboRefreshArbiter::KoboRefreshArbiter(int fbFd, bool sunxi, bool reliableWait, bool debug, QObject *parent)
+    : QObject(parent), fbFd(fbFd), sunxi(sunxi), reliableWait(reliableWait), debug(debug), lastCfg({0})
+{
+    penCleanupTimer = new QTimer(this);
+    penCleanupTimer->setSingleShot(true);
+    penCleanupTimer->setInterval(penCleanupDelay);
+    connect(penCleanupTimer, &QTimer::timeout, this, &KoboRefreshArbiter::cleanupAfterPen);
+}
+
+KoboRefreshArbiter::~KoboRefreshArbiter()
+{
+    if (!markerWaiter)
+        return;
+
+    markerMutex.lock();
+    stopWaiter = true;
+    markerQueued.wakeAll();
+    markerMutex.unlock();
+
+    markerWaiter->wait();
+    delete markerWaiter;
+}
+
+void KoboRefreshArbiter::setVirtualEpdc(KoboVirtualEpdc *epdc)
+{
+    virtualEpdc = epdc;
+}
+
+void KoboRefreshArbiter::setMarkerCompletedHandler(std::function<void(quint32 marker)> handler)
+{
+    markerCompletedHandler = std::move(handler);
+}
+
+bool KoboRefreshArbiter::isPenSafe(const FBInkConfig &cfg)
+{
+    return (cfg.wfm_mode == WFM_DU || cfg.wfm_mode == WFM_A2) && !cfg.is_flashing;
+}
+
+bool KoboRefreshArbiter::holdBackForPen(FBInkConfig *cfg)
+{
+    if (!penMode || isPenSafe(*cfg))
+        return false;
+
+    if (!penTouching)
+    {
+        leavePenMode();
+        return false;
+    }
+
+    // A flash can't be made pen safe. The pixels are in the framebuffer already, the cleanup refresh
+    // will show them.
+    if (cfg->is_flashing)
+    {
+        refreshDeferred = true;
+        return true;
+    }
+
+    // Repaints that follow the pen still have to show up while it writes, in black and white until the
+    // cleanup refresh brings the grays back
+    cfg->wfm_mode = WFM_DU;
+    return false;
+}
+
+int KoboRefreshArbiter::submit(const QRect &region, const FBInkConfig &cfg)
+{
+    if (virtualEpdc)
+    {
+        virtualEpdc->submit(region, cfg.wfm_mode, cfg.is_flashing);
+        return EXIT_SUCCESS;
+    }
+
+    int rv = fbink_refresh(fbFd, region.top(), region.left(), region.width(), region.height(), &cfg);
+
+    if (rv != EXIT_SUCCESS && errno == EPERM)
+    {
+        if (debug)
+            qDebug() << "QPA: Detected framebuffer freeze, attempting to fix ...";
+        unsigned long arg = VESA_NO_BLANKING;
+        if (ioctl(fbFd, FBIOBLANK, arg) == EXIT_SUCCESS)
+            rv = fbink_refresh(fbFd, region.top(), region.left(), region.width(), region.height(), &cfg);
+    }
+
+    return rv;
+}
+
+int KoboRefreshArbiter::refresh(const QRect &region, const FBInkConfig &cfg)
+{
+    QMutexLocker locker(&mutex);
+    lastCfg = cfg;
+
+    FBInkConfig penCfg = cfg;
+    if (holdBackForPen(&penCfg))
+        return EXIT_SUCCESS;
+
+    return submit(region, penCfg);
+}
+
+quint32 KoboRefreshArbiter::refreshTracked(const QRect &region, const FBInkConfig &cfg)
+{
+    QMutexLocker locker(&mutex);
+    lastCfg = cfg;
+
+    FBInkConfig penCfg = cfg;
+    if (holdBackForPen(&penCfg))
+    {
+        QMutexLocker markerLocker(&markerMutex);
+        deferredTracked++;
+        deferredPending++;
+        return RefreshMarker_Deferred;
+    }
+
+    if (submit(region, penCfg) != EXIT_SUCCESS)
+        return RefreshMarker_Failed;
+
+    // Read under the lock, no other refresh can have been sent in between
+    const quint32 marker = virtualEpdc ? virtualEpdc->lastMarker() : fbink_get_last_marker();
+    trackMarker(marker, 0);
+    return marker;
+}
+
+void KoboRefreshArbiter::trackMarker(quint32 marker, int covers)
+{
+    QMutexLocker locker(&markerMutex);
+    pendingMarkers.push_back({marker, QDeadlineTimer(estimatedRefreshMs), covers});
+    if (!markerWaiter)
+    {
+        markerWaiter = QThread::create([this] { waitForMarkers(); });
+        markerWaiter->start();
+    }
+    markerQueued.wakeOne();
+}
+
+bool KoboRefreshArbiter::isPending(quint32 marker)
+{
+    if (marker == RefreshMarker_Deferred)
+        return deferredPending > 0;
+
+    return std::find_if(pendingMarkers.begin(), pendingMarkers.end(), [marker](const PendingMarker &pending) {
+               return pending.marker == marker;
+           }) != pendingMarkers.end();
+}
+
+bool KoboRefreshArbiter::isMarkerComplete(quint32 marker)
+{
+    if (marker == RefreshMarker_Failed)
+        return false;
+
+    QMutexLocker locker(&markerMutex);
+    return !isPending(marker);
+}
+
+bool KoboRefreshArbiter::waitForMarker(quint32 marker, int timeoutMs)
+{
+    if (marker == RefreshMarker_Failed)
+        return false;
+
+    QDeadlineTimer deadline =
+        timeoutMs < 0 ? QDeadlineTimer(QDeadlineTimer::Forever) : QDeadlineTimer(timeoutMs);
+
+    QMutexLocker locker(&markerMutex);
+    while (isPending(marker))
+    {
+        if (!markerCompleted.wait(&markerMutex, deadline))
+            return !isPending(marker);
+    }
+    return true;
+}
+
+void KoboRefreshArbiter::waitForMarkers()
+{
+    QMutexLocker locker(&markerMutex);
+    for (;;)
+    {
+        while (!stopWaiter && pendingMarkers.empty())
+            markerQueued.wait(&markerMutex);
+        if (stopWaiter)
+            return;
+
+        const PendingMarker pending = pendingMarkers.front();
+        locker.unlock();
+
+        // The EPDC completes updates in submission order, so waiting on the oldest is enough. The estimate
+        // runs from the submission, updates queued together complete together instead of one after another.
+        if (reliableWait || virtualEpdc)
+            waitForComplete(pending.marker);
+        else
+            QThread::msleep(pending.estimatedEnd.remainingTime());
+
+        if (markerCompletedHandler)
+        {
+            markerCompletedHandler(pending.marker);
+            if (pending.covers > 0)
+                markerCompletedHandler(RefreshMarker_Deferred);
+        }
+
+        locker.relock();
+        pendingMarkers.pop_front();
+        deferredPending -= pending.covers;
+        markerCompleted.wakeAll();
+    }
+}
+
+void KoboRefreshArbiter::waitForComplete(quint32 marker)
+{
+    if (virtualEpdc)
+        virtualEpdc->waitForComplete(marker);
+    else
+        fbink_wait_for_complete(fbFd, marker);
+}
+
+void KoboRefreshArbiter::waitForLastRefresh()
+{
+    waitForComplete(LAST_MARKER);
+}
+
+void KoboRefreshArbiter::togglePenMode(bool enabled)
+{
+    if (!virtualEpdc)
+        fbink_sunxi_toggle_ntx_pen_mode(fbFd, enabled);
+}
+
+int KoboRefreshArbiter::clear(const QRect &region, const FBInkConfig &cfg)
+{
+    QMutexLocker locker(&mutex);
+
+    // Can't be held back, the pen has to wait for this one
+    const bool restorePenMode = penMode && penTouching;
+    if (penMode)
+        leavePenMode();
+
+    FBInkRect r = {static_cast<unsigned short>(region.left()), static_cast<unsigned short>(region.top()),
+                   static_cast<unsigned short>(region.width()), static_cast<unsigned short>(region.height())};
+    int rv = EXIT_SUCCESS;
+    if (virtualEpdc)
+        virtualEpdc->clear(region, cfg.is_inverted);
+    else
+        rv = fbink_cls(fbFd, &cfg, &r, true);
+
+    if (restorePenMode)
+    {
+        waitForComplete(LAST_MARKER);
+        togglePenMode(true);
+        penMode = true;
+    }
+    return rv;
+}
+
+void KoboRefreshArbiter::penDown()
+{
+    QMutexLocker locker(&mutex);
+    penTouching = true;
+    if (!sunxi || penMode)
+        return;
+
+    togglePenMode(true);
+    penMode = true;
+    if (debug)
+        qDebug() << "Entered pen mode";
+}
+
+void KoboRefreshArbiter::penUp()
+{
+    QMutexLocker locker(&mutex);
+    penTouching = false;
+    if (!penMode)
+        return;
+
+    // Called from the touch thread, the timer lives in the GUI thread
+    QMetaObject::invokeMethod(penCleanupTimer, "start", Qt::QueuedConnection);
+}
+
+bool KoboRefreshArbiter::isPenModeActive()
+{
+    QMutexLocker locker(&mutex);
+    return penMode;
+}
+
+void KoboRefreshArbiter::cleanupAfterPen()
+{
+    QMutexLocker locker(&mutex);
+
+    // Touched again in the meantime, the next pen up schedules the cleanup again
+    if (penTouching || !penMode)
+        return;
+
+    leavePenMode();
+}
+
+void KoboRefreshArbiter::leavePenMode()
+{
+    // NOTE: On sunxi, send a !pen refresh on pen up because otherwise the driver
+    // softlocks,
+    //       and ultimately trips a reboot watchdog...
+    // NOTE: Nickel also toggles pen mode *off* before doing that...
+    //       Let's do the same, as we can still somewhat reliably kill the kernel
+    //       one way or another otherwise...
+    togglePenMode(false);
+
+    FBInkConfig cfg = lastCfg;
+    cfg.wfm_mode = WFM_GL16;
+    cfg.is_flashing = false;
+    const bool submitted = submit(QRect(), cfg) == EXIT_SUCCESS;
+
+    // Refreshes handed out RefreshMarker_Deferred complete with this one. When it fails they stay deferred
+    // until the next cleanup refresh.
+    if (submitted)
+    {
+        markerMutex.lock();
+        const int covers = deferredTracked;
+        deferredTracked = 0;
+        markerMutex.unlock();
+        if (covers > 0)
+            trackMarker(virtualEpdc ? virtualEpdc->lastMarker() : fbink_get_last_marker(), covers);
+    }
+
+    if (debug)
+        qDebug() << "Left pen mode" << (refreshDeferred ? "with deferred refreshes" : "");
+
+    penMode = false;
+    refreshDeferred = false;
+}
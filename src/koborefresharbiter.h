@@ -0,0 +1,118 @@
+#ifndef KOBOREFRESHARBITER_H
+#define KOBOREFRESHARBITER_H
+
+#include <QDeadlineTimer>
+#include <QMutex>
+#include <QObject>
+#include <QRect>
+#include <QWaitCondition>
+#include <deque>
+#include <functional>
+
+#include "einkenums.h"
+#include "fbink.h"
+
+class QThread;
+class QTimer;
+class KoboVirtualEpdc;
+
+// Every refresh goes through here, from the GUI thread as well as from the touch thread.
+//
+// On sunxi the NTX pen mode is on while the pen touches the screen. Any refresh that isn't pen safe
+// in that state can soft-lock the driver and trip the reboot watchdog, so partial ones are sent as DU
+// and flashing ones are held back, all of them covered by the cleanup refresh once the pen is lifted.
+// That cleanup is batched: lifting and touching again quickly, as in handwriting, keeps pen mode on.
+class KoboRefreshArbiter : public QObject
+{
+    Q_OBJECT
+public:
+    KoboRefreshArbiter(int fbFd, bool sunxi, bool reliableWait, bool debug, QObject *parent = nullptr);
+    ~KoboRefreshArbiter();
+
+    // Sends everything to the simulated EPDC instead of the driver, set before the first refresh
+    void setVirtualEpdc(KoboVirtualEpdc *epdc);
+
+    // Called from the marker waiter thread as tracked refreshes complete, set before the first refresh
+    void setMarkerCompletedHandler(std::function<void(quint32 marker)> handler);
+
+    // An empty region refreshes the whole screen
+    int refresh(const QRect &region, const FBInkConfig &cfg);
+
+    // Same as refresh, returns the update marker whose completion can be waited for.
+    // RefreshMarker_Failed when nothing was submitted, RefreshMarker_Deferred when held back for the pen.
+    quint32 refreshTracked(const QRect &region, const FBInkConfig &cfg);
+
+    bool isMarkerComplete(quint32 marker);
+
+    // A negative timeout waits for as long as the EPDC takes
+    bool waitForMarker(quint32 marker, int timeoutMs);
+
+    int clear(const QRect &region, const FBInkConfig &cfg);
+
+    // Blocks until the last refresh submitted is on screen
+    void waitForLastRefresh();
+
+    void penDown();
+
+    void penUp();
+
+    bool isPenModeActive();
+
+private:
+    void cleanupAfterPen();
+
+    void leavePenMode();
+
+    int submit(const QRect &region, const FBInkConfig &cfg);
+
+    void waitForComplete(quint32 marker);
+
+    void togglePenMode(bool enabled);
+
+    static bool isPenSafe(const FBInkConfig &cfg);
+
+    // Queues a submitted marker for the waiter, covering the deferred refreshes so far if covers > 0
+    void trackMarker(quint32 marker, int covers);
+
+    bool isPending(quint32 marker);
+
+    // Makes cfg pen safe, true when the refresh has to wait for the cleanup refresh instead
+    bool holdBackForPen(FBInkConfig *cfg);
+
+    void waitForMarkers();
+
+    QMutex mutex;
+    int fbFd;
+    bool sunxi;
+    bool reliableWait;
+    bool debug;
+    KoboVirtualEpdc *virtualEpdc = nullptr;
+
+    bool penMode = false;
+    bool penTouching = false;
+    bool refreshDeferred = false;
+    FBInkConfig lastCfg;  // night mode and friends for the cleanup refresh
+
+    QTimer *penCleanupTimer;
+    int penCleanupDelay = 400;  // ms after the last pen up before pen mode is left
+
+    // Tracked markers still in flight, the waiter thread blocks on the oldest one
+    struct PendingMarker
+    {
+        quint32 marker;
+        QDeadlineTimer estimatedEnd;  // when it should be on screen, where the wait ioctl is unreliable
+        int covers;                   // deferred refreshes the cleanup refresh behind this marker shows
+    };
+    QMutex markerMutex;
+    QWaitCondition markerQueued;
+    QWaitCondition markerCompleted;
+    std::deque<PendingMarker> pendingMarkers;
+    int deferredTracked = 0;   // held back by the pen, no cleanup refresh sent yet
+    int deferredPending = 0;   // held back by the pen, their cleanup refresh not on screen yet
+    std::function<void(quint32 marker)> markerCompletedHandler;
+    QThread *markerWaiter = nullptr;
+    bool stopWaiter = false;
+    int estimatedRefreshMs = 600;  // stands in for the wait ioctl where it is unreliable
+};
+
+#endif  // KOBOREFRESHARBITER_H
@@ -0,0 +1,94 @@
+#include "kobostartuptrace.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QVector>
+
+namespace
+{
+struct TraceEvent
+{
+    const char *name;
+    qint64 startUs;
+    qint64 durationUs;
+    int tid;
+};
+
+QMutex traceMutex;
+QString tracePath;
+QElapsedTimer traceClock;
+QVector<TraceEvent> traceEvents;
+bool traceEnabled = false;
+}  // namespace
+
+void KoboStartupTrace::enable(const QString &path)
+{
+    QMutexLocker locker(&traceMutex);
+    tracePath = path;
+    traceClock.start();
+    traceEvents.reserve(32);
+    traceEnabled = true;
+}
+
+bool KoboStartupTrace::isEnabled()
+{
+    return traceEnabled;
+}
+
+void KoboStartupTrace::write()
+{
+    QMutexLocker locker(&traceMutex);
+    if (!traceEnabled)
+        return;
+
+    QJsonArray events;
+    for (const TraceEvent &event : qAsConst(traceEvents))
+    {
+        events.append(QJsonObject{{"name", QLatin1String(event.name)},
+                                  {"cat", "startup"},
+                                  {"ph", "X"},
+                                  {"ts", event.startUs},
+                                  {"dur", event.durationUs},
+                                  {"pid", int(getpid())},
+                                  {"tid", event.tid}});
+    }
+
+    QFile file(tracePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qDebug() << "Cannot write the startup trace to" << tracePath;
+        return;
+    }
+    file.write(QJsonDocument(QJsonObject{{"traceEvents", events}, {"displayTimeUnit", "ms"}}).toJson());
+    qDebug() << "Startup trace with" << traceEvents.size() << "phases written to" << tracePath;
+}
+
+KoboStartupTrace::Phase::Phase(const char *name) : name(name)
+{
+    if (traceEnabled)
+        startUs = traceClock.nsecsElapsed() / 1000;
+}
+
+KoboStartupTrace::Phase::~Phase()
+{
+    finish();
+}
+
+void KoboStartupTrace::Phase::finish()
+{
+    if (startUs < 0)
+        return;
+
+    const qint64 endUs = traceClock.nsecsElapsed() / 1000;
+    QMutexLocker locker(&traceMutex);
+    traceEvents.append({name, startUs, endUs - startUs, int(syscall(SYS_gettid))});
+    startUs = -1;
+}
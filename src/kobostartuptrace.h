@@ -0,0 +1,33 @@
+#ifndef KOBOSTARTUPTRACE_H
+#define KOBOSTARTUPTRACE_H
+
+#include <QString>
+
+// Times the phases of the plugin's startup and writes them as Chrome trace JSON, which chrome://tracing
+// and Perfetto open. Enabled with startuptrace=<file>, otherwise phases cost a branch and nothing is kept.
+class KoboStartupTrace
+{
+public:
+    static void enable(const QString &path);
+
+    static bool isEnabled();
+
+    // Writes what was recorded so far, called once startup is over
+    static void write();
+
+    // Records the time from construction to finish() or destruction, from any thread
+    class Phase
+    {
+    public:
+        explicit Phase(const char *name);
+        ~Phase();
+
+        void finish();
+
+    private:
+        const char *name;
+        qint64 startUs = -1;
+    };
+};
+
+#endif  // KOBOSTARTUPTRACE_H
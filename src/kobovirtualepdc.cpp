@@ -0,0 +1,212 @@
+#include "kobovirtualepdc.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+
+#include <QDebug>
+#include <QThread>
+
+#include "einkenums.h"
+
+KoboVirtualEpdc::KoboVirtualEpdc(const QString &backingFile, bool debug)
+    : backingFile(backingFile), debug(debug)
+{
+    clock.start();
+}
+
+KoboVirtualEpdc::~KoboVirtualEpdc()
+{
+    unmap();
+}
+
+uchar *KoboVirtualEpdc::map(int width, int height, int bytesPerLine)
+{
+    const size_t wanted = size_t(height) * bytesPerLine;
+    this->bytesPerLine = bytesPerLine;
+    bytesPerPixel = bytesPerLine / width;
+    if (buffer && wanted == size)
+        return buffer;
+
+    unmap();
+
+    if (backingFile.isEmpty())
+    {
+        buffer = static_cast<uchar *>(calloc(wanted, 1));
+    }
+    else
+    {
+        fd = open(backingFile.toLocal8Bit().constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0 || ftruncate(fd, wanted) != 0)
+        {
+            qDebug() << "Cannot create the virtual framebuffer file" << backingFile;
+            unmap();
+            return nullptr;
+        }
+        void *p = mmap(nullptr, wanted, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        buffer = p == MAP_FAILED ? nullptr : static_cast<uchar *>(p);
+    }
+
+    if (!buffer)
+    {
+        unmap();
+        return nullptr;
+    }
+
+    size = wanted;
+    memset(buffer, 0xff, size);
+
+    if (debug)
+        qDebug() << "Virtual framebuffer of" << size << "bytes"
+                 << (backingFile.isEmpty() ? QStringLiteral("in memory") : "in " + backingFile);
+    return buffer;
+}
+
+void KoboVirtualEpdc::unmap()
+{
+    if (buffer)
+    {
+        if (fd >= 0)
+            munmap(buffer, size);
+        else
+            free(buffer);
+    }
+    if (fd >= 0)
+        close(fd);
+
+    buffer = nullptr;
+    size = 0;
+    fd = -1;
+}
+
+int KoboVirtualEpdc::latencyMs(WFM_MODE_INDEX_T waveform, bool flashing)
+{
+    int ms;
+    switch (waveform)
+    {
+        case WFM_A2:
+            ms = 120;
+            break;
+        case WFM_DU:
+            ms = 260;
+            break;
+        case WFM_GC4:
+            ms = 290;
+            break;
+        default:  // GC16, GL16, REAGL(D) and AUTO which ends up on one of them
+            ms = 450;
+            break;
+    }
+
+    // The flash drives every pixel through black and back
+    return flashing ? ms + ms / 2 : ms;
+}
+
+void KoboVirtualEpdc::retireCompleted(qint64 nowMs)
+{
+    while (!inFlight.empty() && inFlight.front().endMs <= nowMs)
+        inFlight.pop_front();
+}
+
+quint32 KoboVirtualEpdc::clear(const QRect &region, bool inverted)
+{
+    if (!buffer)
+        return 0;
+
+    const QRect screen(0, 0, bytesPerLine / bytesPerPixel, int(size / bytesPerLine));
+    const QRect area = region.isEmpty() ? screen : region.intersected(screen);
+    for (int y = area.top(); y <= area.bottom(); ++y)
+        memset(buffer + y * bytesPerLine + area.left() * bytesPerPixel, inverted ? 0x00 : 0xff,
+               area.width() * bytesPerPixel);
+
+    return submit(region, WFM_GC16, true);
+}
+
+quint32 KoboVirtualEpdc::submit(const QRect &region, WFM_MODE_INDEX_T waveform, bool flashing)
+{
+    QMutexLocker locker(&mutex);
+    const qint64 now = clock.elapsed();
+    retireCompleted(now);
+
+    qint64 start = now;
+    bool collided = false;
+    for (const Update &update : inFlight)
+    {
+        // An empty region is the whole screen, which collides with everything
+        if (region.isEmpty() || update.region.isEmpty() || update.region.intersects(region))
+        {
+            start = qMax(start, update.endMs);
+            collided = true;
+        }
+    }
+    if (int(inFlight.size()) >= maxConcurrentUpdates)
+        start = qMax(start, inFlight[inFlight.size() - maxConcurrentUpdates].endMs);
+
+    if (collided)
+        ++collisionCount;
+
+    // Markers complete in order, an update can't end before the one submitted ahead of it
+    qint64 end = start + latencyMs(waveform, flashing);
+    if (!inFlight.empty())
+        end = qMax(end, inFlight.back().endMs);
+
+    const quint32 marker = nextMarker++;
+    if (nextMarker == LAST_MARKER || nextMarker == RefreshMarker_Deferred)
+        nextMarker = 1;
+    latestMarker = marker;
+    inFlight.push_back({marker, region, end});
+
+    if (debug)
+        qDebug() << "Virtual EPDC: update" << marker << region << "waveform" << waveform
+                 << (collided ? "collides, starts in" : "starts in") << start - now << "ms, takes"
+                 << end - start << "ms";
+    return marker;
+}
+
+bool KoboVirtualEpdc::isComplete(quint32 marker)
+{
+    QMutexLocker locker(&mutex);
+    retireCompleted(clock.elapsed());
+    for (const Update &update : inFlight)
+    {
+        if (update.marker == marker)
+            return false;
+    }
+    return true;
+}
+
+void KoboVirtualEpdc::waitForComplete(quint32 marker)
+{
+    qint64 endMs = -1;
+    {
+        QMutexLocker locker(&mutex);
+        if (marker == LAST_MARKER)
+            marker = latestMarker;
+        for (const Update &update : inFlight)
+        {
+            if (update.marker == marker)
+                endMs = update.endMs;
+        }
+        if (endMs < 0)
+            return;
+        endMs -= clock.elapsed();
+    }
+
+    if (endMs > 0)
+        QThread::msleep(endMs);
+}
+
+quint32 KoboVirtualEpdc::lastMarker()
+{
+    QMutexLocker locker(&mutex);
+    return latestMarker;
+}
+
+int KoboVirtualEpdc::collisions()
+{
+    QMutexLocker locker(&mutex);
+    return collisionCount;
+}
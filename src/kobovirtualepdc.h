@@ -0,0 +1,77 @@
+#ifndef KOBOVIRTUALEPDC_H
+#define KOBOVIRTUALEPDC_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QRect>
+#include <QString>
+#include <deque>
+
+#include "fbink.h"
+
+// Stands in for the framebuffer and the EPDC when the plugin runs with virtualfb on a workstation.
+// The pixels live in memory, or in a shared mapping of a file another process can watch. Refreshes
+// take the time the waveform takes on a device, an update overlapping one still in flight waits for
+// it as the mxcfb collision handling would, and markers complete in submission order.
+class KoboVirtualEpdc
+{
+public:
+    KoboVirtualEpdc(const QString &backingFile, bool debug);
+    ~KoboVirtualEpdc();
+
+    // (Re)creates the buffer, on rotation too. Returns nullptr when it can't be allocated.
+    uchar *map(int width, int height, int bytesPerLine);
+
+    size_t bufferSize() const { return size; }
+
+    // Returns the marker of the update, never 0
+    quint32 submit(const QRect &region, WFM_MODE_INDEX_T waveform, bool flashing);
+
+    // Fills the region with white, black when inverted, and refreshes it with a flashing GC16
+    quint32 clear(const QRect &region, bool inverted);
+
+    bool isComplete(quint32 marker);
+
+    // LAST_MARKER waits for the latest update
+    void waitForComplete(quint32 marker);
+
+    quint32 lastMarker();
+
+    int collisions();
+
+    // What the update takes on a Carta panel, roughly
+    static int latencyMs(WFM_MODE_INDEX_T waveform, bool flashing);
+
+private:
+    struct Update
+    {
+        quint32 marker;
+        QRect region;
+        qint64 endMs;
+    };
+
+    void unmap();
+
+    void retireCompleted(qint64 nowMs);
+
+    QString backingFile;
+    bool debug;
+
+    uchar *buffer = nullptr;
+    size_t size = 0;
+    int bytesPerLine = 0;
+    int bytesPerPixel = 1;
+    int fd = -1;
+
+    QMutex mutex;
+    QElapsedTimer clock;
+    std::deque<Update> inFlight;
+    quint32 nextMarker = 1;
+    quint32 latestMarker = 0;
+    int collisionCount = 0;
+
+    // Concurrent updates the EPDC has LUTs for, more wait for the oldest to finish
+    static const int maxConcurrentUpdates = 16;
+};
+
+#endif  // KOBOVIRTUALEPDC_H
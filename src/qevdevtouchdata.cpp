@@ -44,14 +44,16 @@
 #include <math.h>
 
 #include <QGuiApplication>
-#include <QHash>
 #include <QLoggingCategory>
 #include <QSocketNotifier>
 #include <QStringList>
 #include <QTouchDevice>
+#include <algorithm>
 #include <mutex>
 
+#include "kobolatencytracker.h"
 #include "qevdevtouchhandler.h"
+#include "qevdevtouchrecorder.h"
 
 QT_BEGIN_NAMESPACE
 
@@ -78,8 +80,11 @@ QPointF QEvdevTouchScreenData::transformTouchPoint(const QPointF &p)
 }
 
 QEvdevTouchScreenData::QEvdevTouchScreenData(QEvdevTouchScreenHandler *q_ptr, const QStringList &args)
-    : q(q_ptr),
+    : m_decoder(&QEvdevTouchScreenData::decode<0>),
+      m_quirks(0),
+      q(q_ptr),
       m_lastEventType(-1),
+      m_touchPointCount(0),
       m_currentSlot(0),
       m_timeStamp(0),
       m_lastTimeStamp(0),
@@ -89,6 +94,7 @@ QEvdevTouchScreenData::QEvdevTouchScreenData(QEvdevTouchScreenHandler *q_ptr, co
       hw_range_y_max(0),
       hw_pressure_min(0),
       hw_pressure_max(0),
+      hw_slot_count(0),
       m_forceToActiveWindow(false),
       m_typeB(false),
       m_singleTouch(false),
@@ -107,12 +113,184 @@ QEvdevTouchScreenData::QEvdevTouchScreenData(QEvdevTouchScreenHandler *q_ptr, co
     }
 }
 
+void QEvdevTouchScreenData::ContactSlots::reset(int capacity, bool slotted)
+{
+    m_slotted = slotted;
+    m_keys.clear();
+    m_contacts.clear();
+    m_written.clear();
+    m_keys.reserve(capacity);
+    m_contacts.reserve(capacity);
+
+    if (m_slotted)
+    {
+        // Every slot exists up front, an unused one has no state
+        Contact inactive;
+        inactive.state = static_cast<Qt::TouchPointState>(0);
+        for (int slot = 0; slot < capacity; ++slot)
+        {
+            m_keys.push_back(slot);
+            m_contacts.push_back(inactive);
+            m_written.push_back(false);
+        }
+    }
+}
+
+void QEvdevTouchScreenData::ContactSlots::clear()
+{
+    if (!m_slotted)
+    {
+        m_keys.clear();
+        m_contacts.clear();
+        return;
+    }
+
+    for (int slot = 0; slot < count(); ++slot)
+    {
+        m_contacts[slot] = Contact();
+        m_contacts[slot].state = static_cast<Qt::TouchPointState>(0);
+        m_written[slot] = true;
+    }
+}
+
+void QEvdevTouchScreenData::ContactSlots::swap(ContactSlots &other)
+{
+    m_keys.swap(other.m_keys);
+    m_contacts.swap(other.m_contacts);
+    m_written.swap(other.m_written);
+    std::swap(m_slotted, other.m_slotted);
+}
+
+void QEvdevTouchScreenData::ContactSlots::catchUp(ContactSlots &last)
+{
+    // Called right after swapping in the frame before the last one. Only a slot written during the
+    // frame or active before it can differ, everything else already matches.
+    Q_ASSERT(m_slotted && last.m_slotted);
+    if (count() != last.count())
+    {
+        *this = last;
+    }
+    else
+    {
+        for (int slot = 0; slot < count(); ++slot)
+        {
+            if (last.m_written[slot] || m_contacts[slot].state)
+                m_contacts[slot] = last.m_contacts[slot];
+        }
+    }
+    std::fill(m_written.begin(), m_written.end(), false);
+    std::fill(last.m_written.begin(), last.m_written.end(), false);
+}
+
+int QEvdevTouchScreenData::ContactSlots::indexOf(int key) const
+{
+    if (m_slotted && key >= 0 && key < count() && m_keys[key] == key)
+        return key;
+
+    for (int i = 0; i < count(); ++i)
+    {
+        if (m_keys[i] == key)
+            return i;
+    }
+    return -1;
+}
+
+QEvdevTouchScreenData::Contact &QEvdevTouchScreenData::ContactSlots::operator[](int key)
+{
+    int index = indexOf(key);
+    if (index < 0)
+    {
+        // Only grows when a device reports more contacts than it announced
+        index = count();
+        m_keys.push_back(key);
+        m_contacts.push_back(Contact());
+        if (m_slotted)
+            m_written.push_back(false);
+    }
+    if (m_slotted)
+        m_written[index] = true;
+    return m_contacts[index];
+}
+
+const QEvdevTouchScreenData::Contact *QEvdevTouchScreenData::ContactSlots::find(int key) const
+{
+    const int index = indexOf(key);
+    return index < 0 ? nullptr : &m_contacts[index];
+}
+
+QEvdevTouchScreenData::Contact QEvdevTouchScreenData::ContactSlots::value(int key) const
+{
+    const Contact *contact = find(key);
+    return contact ? *contact : Contact();
+}
+
+void QEvdevTouchScreenData::ContactSlots::remove(int key)
+{
+    const int index = indexOf(key);
+    if (index >= 0)
+        removeAt(index);
+}
+
+void QEvdevTouchScreenData::ContactSlots::removeAt(int index)
+{
+    Q_ASSERT(!m_slotted);
+
+    // Order doesn't matter, move the last entry into the hole
+    m_keys[index] = m_keys.back();
+    m_contacts[index] = m_contacts.back();
+    m_keys.pop_back();
+    m_contacts.pop_back();
+}
+
+void QEvdevTouchScreenData::initContactSlots()
+{
+    const bool slotted = m_typeB && hw_slot_count > 0;
+    const int capacity = slotted ? hw_slot_count : 16;
+
+    m_contacts.reset(capacity, slotted);
+    m_lastContacts.reset(capacity, slotted);
+    m_assignCandidates.reset(capacity, false);
+    m_assignPending.reset(capacity, false);
+    m_assignResult.reset(capacity, false);
+
+    m_touchPoints.reserve(capacity);
+    m_lastTouchPoints.reserve(capacity);
+}
+
+QWindowSystemInterface::TouchPoint &QEvdevTouchScreenData::nextTouchPoint()
+{
+    // Reuse the points of the frame before the last one
+    if (m_touchPointCount == m_touchPoints.size())
+        m_touchPoints.append(QWindowSystemInterface::TouchPoint());
+
+    QWindowSystemInterface::TouchPoint &tp = m_touchPoints[m_touchPointCount++];
+    tp.uniqueId = QPointingDeviceUniqueId();
+    tp.rotation = 0;
+    tp.velocity = QVector2D();
+    return tp;
+}
+
+void QEvdevTouchScreenData::setRawPosition(QWindowSystemInterface::TouchPoint &tp, const QPointF &pos)
+{
+    // Overwrites the single entry in place. That only allocates when the vector is still shared with an
+    // event the GUI thread hasn't delivered yet, or the first time a point is used.
+    if (tp.rawPositions.size() == 1)
+    {
+        tp.rawPositions[0] = pos;
+    }
+    else
+    {
+        tp.rawPositions.clear();
+        tp.rawPositions.append(pos);
+    }
+}
+
 void QEvdevTouchScreenData::addTouchPoint(const Contact &contact, Qt::TouchPointStates *combinedStates)
 {
     if (contact.x == -1 && contact.y == -1)
         return;  // failsafe, for devices with ABS_MT_TRACKING_ID not starting at 0
 
-    QWindowSystemInterface::TouchPoint tp;
+    QWindowSystemInterface::TouchPoint &tp = nextTouchPoint();
     tp.id = contact.trackingId;
     tp.flags = contact.flags;
     tp.state = contact.state;
@@ -127,78 +305,121 @@ void QEvdevTouchScreenData::addTouchPoint(const Contact &contact, Qt::TouchPoint
     tp.normalPosition = QPointF((contact.x - hw_range_x_min) / qreal(hw_range_x_max - hw_range_x_min),
                                 (contact.y - hw_range_y_min) / qreal(hw_range_y_max - hw_range_y_min));
 
-    tp.rawPositions.append(QPointF(contact.x, contact.y));
+    setRawPosition(tp, QPointF(contact.x, contact.y));
 
     qCDebug(qLcEvdevTouch) << "Adding touch point:" << tp.id << tp.uniqueId;
-    qCDebug(qLcEvdevTouch) << "Touchpoint raw position:" << tp.rawPositions.last();
+    qCDebug(qLcEvdevTouch) << "Touchpoint raw position:" << tp.rawPositions.constFirst();
     qCDebug(qLcEvdevTouch) << "Touchpoint normal position:" << tp.normalPosition;
 
     tp.normalPosition = transformTouchPoint(tp.normalPosition);
 
     qCDebug(qLcEvdevTouch) << "Touchpoint transformed normal position:" << tp.normalPosition;
+}
 
-    m_touchPoints.append(tp);
+template <>
+void QEvdevTouchScreenData::fillDecoderTable<-1>(Decoder *)
+{
+}
+
+template <int Flags>
+void QEvdevTouchScreenData::fillDecoderTable(Decoder *table)
+{
+    table[Flags] = &QEvdevTouchScreenData::decode<Flags>;
+    fillDecoderTable<Flags - 1>(table);
 }
 
-void QEvdevTouchScreenData::processInputEvent(input_event *data)
+void QEvdevTouchScreenData::selectDecoder()
 {
+    Decoder decoders[DecodeAll + 1];
+    fillDecoderTable<DecodeAll>(decoders);
+
+    int flags = m_quirks;
+    if (m_typeB)
+        flags |= DecodeTypeB;
+    if (m_singleTouch)
+        flags |= DecodeSingleTouch;
+    if (m_btnTool)
+        flags |= DecodeBtnTool;
+
+    qCDebug(qLcEvdevTouch, "evdevtouch: %ls: decoder flags 0x%x", qUtf16Printable(deviceNode), flags);
+    m_decoder = decoders[flags];
+}
+
+template <int Flags>
+void QEvdevTouchScreenData::decode(input_event *data)
+{
+    // All of these are constants, the compiler drops the branches that don't apply to a variant
+    const bool typeB = Flags & DecodeTypeB;
+    const bool singleTouch = Flags & DecodeSingleTouch;
+    const bool btnTool = Flags & DecodeBtnTool;
+    const bool modern = Flags & DecodeModern;
+    const bool sunxiPen = Flags & DecodeSunxiPen;
+
     if (data->type == EV_ABS)
     {
-        if (data->code == ABS_MT_POSITION_X || (m_singleTouch && data->code == ABS_X))
+        if (modern && data->code == ABS_MT_TOOL_TYPE)
+        {
+            if (data->value == MT_TOOL_FINGER)
+                m_contacts[m_currentSlot].tool = FINGER;
+            else if (data->value == MT_TOOL_PEN)
+                m_contacts[m_currentSlot].tool = PEN;
+        }
+        else if (data->code == ABS_MT_POSITION_X || ((modern || singleTouch) && data->code == ABS_X))
         {
             qCDebug(qLcEvdevTouch) << "EV_ABS MT_POS_X" << data->value;
             m_currentData.x = qBound(hw_range_x_min, data->value, hw_range_x_max);
-            if (m_singleTouch)
+            if (singleTouch || typeB)
             {
-                m_contacts[m_currentSlot].x = m_currentData.x;
-                qCDebug(qLcEvdevTouch) << "EV_ABS MT_POS_X Single Touch";
-            }
-            if (m_typeB)
-            {
-                qCDebug(qLcEvdevTouch) << "EV_ABS MT_POS_X Type B";
-                m_contacts[m_currentSlot].x = m_currentData.x;
-                if (m_contacts[m_currentSlot].state == Qt::TouchPointStationary)
-                    m_contacts[m_currentSlot].state = Qt::TouchPointMoved;
+                Contact &contact = m_contacts[m_currentSlot];
+                contact.x = m_currentData.x;
+                if (typeB && contact.state == Qt::TouchPointStationary)
+                    contact.state = Qt::TouchPointMoved;
             }
         }
-        else if (data->code == ABS_MT_POSITION_Y || (m_singleTouch && data->code == ABS_Y))
+        else if (data->code == ABS_MT_POSITION_Y || ((modern || singleTouch) && data->code == ABS_Y))
         {
-            m_currentData.y = qBound(hw_range_y_min, data->value, hw_range_y_max);
             qCDebug(qLcEvdevTouch) << "EV_ABS MT_POS_Y" << data->value;
-            if (m_singleTouch)
-            {
-                m_contacts[m_currentSlot].y = m_currentData.y;
-                qCDebug(qLcEvdevTouch) << "EV_ABS MT_POS_Y Single touch";
-            }
-            if (m_typeB)
+            m_currentData.y = qBound(hw_range_y_min, data->value, hw_range_y_max);
+            if (singleTouch || typeB)
             {
-                qCDebug(qLcEvdevTouch) << "EV_ABS MT_POS_Y Type B";
-                m_contacts[m_currentSlot].y = m_currentData.y;
-                if (m_contacts[m_currentSlot].state == Qt::TouchPointStationary)
-                    m_contacts[m_currentSlot].state = Qt::TouchPointMoved;
+                Contact &contact = m_contacts[m_currentSlot];
+                contact.y = m_currentData.y;
+                if (typeB && contact.state == Qt::TouchPointStationary)
+                    contact.state = Qt::TouchPointMoved;
             }
         }
         else if (data->code == ABS_MT_TRACKING_ID)
         {
-            m_currentData.trackingId = data->value;
+            if (sunxiPen && data->value == -1)
+            {
+                // Contacts are lifted through BTN_TOOL_*, only the pen has a refresh to flush
+                const Contact *contact = m_contacts.find(m_currentSlot);
+                if (contact && contact->tool == PEN)
+                    penLifted();
+            }
+            else
+            {
+                m_currentData.trackingId = data->value;
 
-            // QT apparently can't handle high tracking IDs well?
-            if (m_currentData.trackingId > 2)
-                m_currentData.trackingId = 1;
+                // QT apparently can't handle high tracking IDs well?
+                if (!modern && m_currentData.trackingId > 2)
+                    m_currentData.trackingId = 1;
 
-            qCDebug(qLcEvdevTouch) << "EV_ABS TRACKING_ID " << m_currentData.trackingId;
-            if (m_typeB)
-            {
-                if (m_currentData.trackingId == -1)
+                qCDebug(qLcEvdevTouch) << "EV_ABS TRACKING_ID " << m_currentData.trackingId;
+                if (typeB)
                 {
-                    m_contacts[m_currentSlot].state = Qt::TouchPointReleased;
-                    qCDebug(qLcEvdevTouch) << "EV_ABS TRACKING_ID = -1 touch point released";
-                }
-                else
-                {
-                    m_contacts[m_currentSlot].state = Qt::TouchPointPressed;
-                    m_contacts[m_currentSlot].trackingId = m_currentData.trackingId;
-                    qCDebug(qLcEvdevTouch) << "EV_ABS TRACKING_ID != -1 touch point pressed";
+                    Contact &contact = m_contacts[m_currentSlot];
+                    if (m_currentData.trackingId == -1)
+                    {
+                        contact.state = Qt::TouchPointReleased;
+                        qCDebug(qLcEvdevTouch) << "EV_ABS TRACKING_ID = -1 touch point released";
+                    }
+                    else if (!modern || m_currentData.trackingId != contact.trackingId)
+                    {
+                        contact.state = Qt::TouchPointPressed;
+                        contact.trackingId = m_currentData.trackingId;
+                        qCDebug(qLcEvdevTouch) << "EV_ABS TRACKING_ID != -1 touch point pressed";
+                    }
                 }
             }
         }
@@ -206,19 +427,18 @@ void QEvdevTouchScreenData::processInputEvent(input_event *data)
         {
             qCDebug(qLcEvdevTouch) << "EV_ABS TOUCH_MAJOR";
             m_currentData.maj = data->value;
-            if (data->value == 0 && !m_btnTool)
+            if (data->value == 0 && !btnTool)
                 m_currentData.state = Qt::TouchPointReleased;
-            if (m_typeB)
+            if (typeB)
                 m_contacts[m_currentSlot].maj = m_currentData.maj;
         }
         else if (data->code == ABS_PRESSURE || data->code == ABS_MT_PRESSURE)
         {
-            qCDebug(qLcEvdevTouch) << "EV_ABS PRESSURE";
             if (Q_UNLIKELY(qLcEvents().isDebugEnabled()))
                 qCDebug(qLcEvents, "EV_ABS code 0x%x: pressure %d; bounding to [%d,%d]", data->code,
                         data->value, hw_pressure_min, hw_pressure_max);
             m_currentData.pressure = qBound(hw_pressure_min, data->value, hw_pressure_max);
-            if (m_typeB || m_singleTouch)
+            if (typeB || singleTouch)
                 m_contacts[m_currentSlot].pressure = m_currentData.pressure;
         }
         else if (data->code == ABS_MT_SLOT)
@@ -227,21 +447,37 @@ void QEvdevTouchScreenData::processInputEvent(input_event *data)
             qCDebug(qLcEvdevTouch) << "EV_ABS SLOT";
         }
     }
-    else if (data->type == EV_KEY && !m_typeB)
+    else if (data->type == EV_KEY)
     {
-        qCDebug(qLcEvdevTouch) << "EV_KEY";
-        if (data->code == BTN_TOUCH && data->value == 0)
+        if (modern)
         {
-            m_contacts[m_currentSlot].state = Qt::TouchPointReleased;
-            qCDebug(qLcEvdevTouch) << "EV_KEY BTN_TOUCH 0 touchpoint released";
+            // To detect up/down state on "snow" protocol without weird slot shenanigans...
+            // It's out-of-band of MT events, so, it unfortunately means *all* contacts,
+            // not a specific slot...
+            // (i.e., you won't get an EV_KEY:BTN_TOUCH:0 until *all* contact points have been lifted).
+            if (data->code == BTN_TOOL_PEN || data->code == BTN_TOOL_FINGER)
+            {
+                Contact &contact = m_contacts[m_currentSlot];
+                contact.tool = data->code == BTN_TOOL_PEN ? PEN : FINGER;
+                contact.state = data->value > 0 ? Qt::TouchPointPressed : Qt::TouchPointReleased;
+            }
         }
-
-        // On some devices (Glo HD) ABS_MT_TRACKING_ID starts at 1
-        // => there will be malformed events with ABS_MT_TRACKING_ID 0 => filter those at addTouchPoint().
-        if (data->code == BTN_TOUCH && data->value == 1)
+        else if (!typeB)
         {
-            m_contacts[m_currentSlot].state = Qt::TouchPointPressed;
-            qCDebug(qLcEvdevTouch) << "EV_KEY BTN_TOUCH 1 touchpoint pressed";
+            qCDebug(qLcEvdevTouch) << "EV_KEY";
+            if (data->code == BTN_TOUCH && data->value == 0)
+            {
+                m_contacts[m_currentSlot].state = Qt::TouchPointReleased;
+                qCDebug(qLcEvdevTouch) << "EV_KEY BTN_TOUCH 0 touchpoint released";
+            }
+
+            // On some devices (Glo HD) ABS_MT_TRACKING_ID starts at 1
+            // => there will be malformed events with ABS_MT_TRACKING_ID 0 => filter those at addTouchPoint().
+            if (data->code == BTN_TOUCH && data->value == 1)
+            {
+                m_contacts[m_currentSlot].state = Qt::TouchPointPressed;
+                qCDebug(qLcEvdevTouch) << "EV_KEY BTN_TOUCH 1 touchpoint pressed";
+            }
         }
     }
     else if (data->type == EV_SYN && data->code == SYN_MT_REPORT && m_lastEventType != EV_SYN)
@@ -259,134 +495,155 @@ void QEvdevTouchScreenData::processInputEvent(input_event *data)
     else if (data->type == EV_SYN && data->code == SYN_REPORT)
     {
         qCDebug(qLcEvdevTouch) << "EV_SYN SYN_REPORT";
+        processSynReport(data);
+    }
 
-        // Ensure valid IDs even when the driver does not report ABS_MT_TRACKING_ID.
-        if (!m_contacts.isEmpty() && m_contacts.constBegin().value().trackingId == -1)
-            assignIds();
+    qCDebug(qLcEvdevTouch) << "Contact state:" << m_contacts.value(0).state;
 
-        std::unique_lock<QMutex> locker;
-        if (m_filtered)
-            locker = std::unique_lock<QMutex>{m_mutex};
+    m_lastEventType = data->type;
+}
 
-        // update timestamps
-        m_lastTimeStamp = m_timeStamp;
-        m_timeStamp = data->time.tv_sec + data->time.tv_usec / 1000000.0;
+void QEvdevTouchScreenData::processSynReport(const input_event *data)
+{
+    // Ensure valid IDs even when the driver does not report ABS_MT_TRACKING_ID.
+    if (!m_typeB && !m_contacts.isEmpty() && m_contacts.at(0).trackingId == -1)
+        assignIds();
 
-        m_lastTouchPoints = m_touchPoints;
-        m_touchPoints.clear();
-        Qt::TouchPointStates combinedStates;
-        bool hasPressure = false;
+    std::unique_lock<QMutex> locker;
+    if (m_filtered)
+        locker = std::unique_lock<QMutex>{m_mutex};
 
-        for (auto i = m_contacts.begin(), end = m_contacts.end(); i != end; /*erasing*/)
-        {
-            auto it = i++;
+    // update timestamps
+    m_lastTimeStamp = m_timeStamp;
+    m_timeStamp = data->time.tv_sec + data->time.tv_usec / 1000000.0;
 
-            Contact &contact(it.value());
+    // The current points become the last ones, the older list gets overwritten in place.
+    m_lastTouchPoints.swap(m_touchPoints);
+    m_touchPointCount = 0;
+    Qt::TouchPointStates combinedStates;
+    bool hasPressure = false;
 
-            if (!contact.state)
-                continue;
+    for (int i = 0; i < m_contacts.count(); /*erasing*/)
+    {
+        Contact &contact(m_contacts.at(i));
+
+        if (!contact.state)
+        {
+            ++i;
+            continue;
+        }
 
-            int key = m_typeB ? it.key() : contact.trackingId;
-            if (!m_typeB && m_lastContacts.contains(key))
+        int key = m_typeB ? m_contacts.keyAt(i) : contact.trackingId;
+        const Contact *prev = m_typeB ? nullptr : m_lastContacts.find(key);
+        if (prev)
+        {
+            if (contact.state == Qt::TouchPointReleased)
             {
-                const Contact &prev(m_lastContacts.value(key));
-                if (contact.state == Qt::TouchPointReleased)
-                {
-                    // Copy over the previous values for released points, just in case.
-                    contact.x = prev.x;
-                    contact.y = prev.y;
-                    contact.maj = prev.maj;
-                }
-                else
-                {
-                    contact.state = (prev.x == contact.x && prev.y == contact.y) ? Qt::TouchPointStationary
-                                                                                 : Qt::TouchPointMoved;
-                }
+                // Copy over the previous values for released points, just in case.
+                contact.x = prev->x;
+                contact.y = prev->y;
+                contact.maj = prev->maj;
             }
-
-            // Avoid reporting a contact in released state more than once.
-            if (!m_typeB && contact.state == Qt::TouchPointReleased && !m_lastContacts.contains(key))
+            else
             {
-                m_contacts.erase(it);
-                qCDebug(qLcEvdevTouch) << "Erase contact since touchpoint released";
-                continue;
+                contact.state = (prev->x == contact.x && prev->y == contact.y) ? Qt::TouchPointStationary
+                                                                               : Qt::TouchPointMoved;
             }
+        }
 
-            if (contact.pressure)
-                hasPressure = true;
-
-            addTouchPoint(contact, &combinedStates);
+        // Avoid reporting a contact in released state more than once.
+        if (!m_typeB && contact.state == Qt::TouchPointReleased && !prev)
+        {
+            m_contacts.removeAt(i);
+            qCDebug(qLcEvdevTouch) << "Erase contact since touchpoint released";
+            continue;
         }
 
-        // Now look for contacts that have disappeared since the last sync.
-        for (auto it = m_lastContacts.begin(), end = m_lastContacts.end(); it != end; ++it)
+        if (contact.pressure)
+            hasPressure = true;
+
+        addTouchPoint(contact, &combinedStates);
+        ++i;
+    }
+
+    // Now look for contacts that have disappeared since the last sync.
+    for (int i = 0; i < m_lastContacts.count(); ++i)
+    {
+        Contact &contact(m_lastContacts.at(i));
+        int key = m_typeB ? m_lastContacts.keyAt(i) : contact.trackingId;
+        if (m_typeB)
         {
-            Contact &contact(it.value());
-            int key = m_typeB ? it.key() : contact.trackingId;
-            if (m_typeB)
+            if (contact.state && contact.trackingId != m_contacts.value(key).trackingId)
             {
-                if (contact.trackingId != m_contacts[key].trackingId && contact.state)
-                {
-                    contact.state = Qt::TouchPointReleased;
-                    addTouchPoint(contact, &combinedStates);
-                }
+                contact.state = Qt::TouchPointReleased;
+                addTouchPoint(contact, &combinedStates);
             }
-            else
+        }
+        else
+        {
+            if (!m_contacts.contains(key))
             {
-                if (!m_contacts.contains(key))
-                {
-                    contact.state = Qt::TouchPointReleased;
-                    addTouchPoint(contact, &combinedStates);
-                }
+                contact.state = Qt::TouchPointReleased;
+                addTouchPoint(contact, &combinedStates);
             }
         }
+    }
 
-        // Remove contacts that have just been reported as released.
-        for (auto i = m_contacts.begin(), end = m_contacts.end(); i != end; /*erasing*/)
-        {
-            auto it = i++;
-
-            Contact &contact(it.value());
-
-            if (!contact.state)
-                continue;
+    // Remove contacts that have just been reported as released.
+    for (int i = 0; i < m_contacts.count(); /*erasing*/)
+    {
+        Contact &contact(m_contacts.at(i));
 
-            if (contact.state == Qt::TouchPointReleased)
+        if (contact.state == Qt::TouchPointReleased)
+        {
+            if (m_typeB)
             {
-                if (m_typeB)
-                    contact.state = static_cast<Qt::TouchPointState>(0);
-                else
-                {
-                    m_contacts.erase(it);
-                    qCDebug(qLcEvdevTouch) << "Contact Erase since state is released";
-                }
+                contact.state = static_cast<Qt::TouchPointState>(0);
             }
             else
             {
-                contact.state = Qt::TouchPointStationary;
+                m_contacts.removeAt(i);
+                qCDebug(qLcEvdevTouch) << "Contact Erase since state is released";
+                continue;
             }
         }
+        else if (contact.state)
+        {
+            contact.state = Qt::TouchPointStationary;
+        }
+        ++i;
+    }
 
+    // Slots persist across frames, type A contacts are rebuilt from scratch every frame. The slot
+    // buffers trade places and the new current one only copies the slots that changed.
+    if (m_contacts.isSlotted())
+    {
+        m_lastContacts.swap(m_contacts);
+        m_contacts.catchUp(m_lastContacts);
+    }
+    else if (m_typeB || m_singleTouch)
+    {
         m_lastContacts = m_contacts;
-        if (!m_typeB && !m_singleTouch)
-            m_contacts.clear();
-
-        if (!m_touchPoints.isEmpty() && (hasPressure || combinedStates != Qt::TouchPointStationary))
-            reportPoints();
+    }
+    else
+    {
+        m_lastContacts.swap(m_contacts);
+        m_contacts.clear();
     }
 
-    qCDebug(qLcEvdevTouch) << "Contact state:" << m_contacts[0].state;
+    while (m_touchPoints.size() > m_touchPointCount)
+        m_touchPoints.removeLast();
 
-    m_lastEventType = data->type;
+    if (!m_touchPoints.isEmpty() && (hasPressure || combinedStates != Qt::TouchPointStationary))
+        reportPoints();
 }
 
-int QEvdevTouchScreenData::findClosestContact(const QHash<int, Contact> &contacts, int x, int y, int *dist)
+int QEvdevTouchScreenData::findClosestContact(const ContactSlots &contacts, int x, int y, int *dist)
 {
     int minDist = -1, id = -1;
-    for (QHash<int, Contact>::const_iterator it = contacts.constBegin(), ite = contacts.constEnd(); it != ite;
-         ++it)
+    for (int i = 0; i < contacts.count(); ++i)
     {
-        const Contact &contact(it.value());
+        const Contact &contact(contacts.at(i));
         int dx = x - contact.x;
         int dy = y - contact.y;
         int dist = dx * dx + dy * dy;
@@ -403,42 +660,47 @@ int QEvdevTouchScreenData::findClosestContact(const QHash<int, Contact> &contact
 
 void QEvdevTouchScreenData::assignIds()
 {
-    QHash<int, Contact> candidates = m_lastContacts, pending = m_contacts, newContacts;
+    ContactSlots &candidates = m_assignCandidates;
+    ContactSlots &pending = m_assignPending;
+    ContactSlots &newContacts = m_assignResult;
+    candidates = m_lastContacts;
+    pending = m_contacts;
+    newContacts.clear();
+
     int maxId = -1;
-    QHash<int, Contact>::iterator it, ite, bestMatch;
     while (!pending.isEmpty() && !candidates.isEmpty())
     {
-        int bestDist = -1, bestId = 0;
-        for (it = pending.begin(), ite = pending.end(); it != ite; ++it)
+        int bestDist = -1, bestId = 0, bestMatch = -1;
+        for (int i = 0; i < pending.count(); ++i)
         {
             int dist;
-            int id = findClosestContact(candidates, it->x, it->y, &dist);
+            int id = findClosestContact(candidates, pending.at(i).x, pending.at(i).y, &dist);
             if (id >= 0 && (bestDist == -1 || dist < bestDist))
             {
                 bestDist = dist;
                 bestId = id;
-                bestMatch = it;
+                bestMatch = i;
             }
         }
         if (bestDist >= 0)
         {
-            bestMatch->trackingId = bestId;
-            newContacts.insert(bestId, *bestMatch);
+            pending.at(bestMatch).trackingId = bestId;
+            newContacts.insert(bestId, pending.at(bestMatch));
             candidates.remove(bestId);
-            pending.erase(bestMatch);
+            pending.removeAt(bestMatch);
             if (bestId > maxId)
                 maxId = bestId;
         }
     }
     if (candidates.isEmpty())
     {
-        for (it = pending.begin(), ite = pending.end(); it != ite; ++it)
+        for (int i = 0; i < pending.count(); ++i)
         {
-            it->trackingId = ++maxId;
-            newContacts.insert(it->trackingId, *it);
+            pending.at(i).trackingId = ++maxId;
+            newContacts.insert(pending.at(i).trackingId, pending.at(i));
         }
     }
-    m_contacts = newContacts;
+    m_contacts.swap(newContacts);
 }
 
 QRect QEvdevTouchScreenData::screenGeometry() const
@@ -492,10 +754,16 @@ void QEvdevTouchScreenData::reportPoints()
         qCDebug(qLcEvdevTouch) << "Registering touch point:" << tp << tp.state;
     }
 
+    if (q->m_recorder && q->m_recorder->isDumping())
+        q->m_recorder->dumpPoints(m_timeStamp, m_touchPoints);
+
+    if (q->m_latency)
+        q->m_latency->touchReported(m_timeStamp);
+
     // Let qguiapp pick the target window.
     if (m_filtered)
         emit q->touchPointsUpdated();
-    else
+    else if (!q->coalesceTouchPoints(m_touchPoints))
         QWindowSystemInterface::handleTouchEvent(nullptr, q->touchDevice(), m_touchPoints);
 }
 
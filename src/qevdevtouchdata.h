@@ -44,6 +44,8 @@
 #include <linux/input.h>
 #include <qpa/qwindowsysteminterface.h>
 
+#include <vector>
+
 #include "qevdevtouchfilter_p.h"
 
 
@@ -59,13 +61,35 @@ public:
     QEvdevTouchScreenData(QEvdevTouchScreenHandler *q_ptr, const QStringList &args);
 
     virtual QPointF transformTouchPoint(const QPointF &p);
-    virtual void processInputEvent(input_event *data);
+    void processInputEvent(input_event *data) { (this->*m_decoder)(data); }
+    void selectDecoder();
     void assignIds();
 
+    // Protocol variants and device quirks the decoder is specialized for
+    enum DecodeFlag
+    {
+        DecodeTypeB = 0x01,
+        DecodeSingleTouch = 0x02,
+        DecodeBtnTool = 0x04,
+        DecodeModern = 0x08,    // tool types, ABS_X/ABS_Y on multitouch devices, raw tracking ids
+        DecodeSunxiPen = 0x10,  // a lifted pen keeps its contact, strokes are flushed instead
+        DecodeAll = 0x1f
+    };
+    typedef void (QEvdevTouchScreenData::*Decoder)(input_event *data);
+    template <int Flags>
+    void decode(input_event *data);
+    template <int Flags>
+    static void fillDecoderTable(Decoder *table);
+    virtual void penLifted() {}
+
+    Decoder m_decoder;
+    int m_quirks;  // DecodeModern and DecodeSunxiPen, set by the subclass
+
     QEvdevTouchScreenHandler *q;
     int m_lastEventType;
     QList<QWindowSystemInterface::TouchPoint> m_touchPoints;
     QList<QWindowSystemInterface::TouchPoint> m_lastTouchPoints;
+    int m_touchPointCount;
 
     enum Tool
     {
@@ -82,18 +106,57 @@ public:
         int pressure = 0;
         Qt::TouchPointState state = Qt::TouchPointPressed;
         QTouchEvent::TouchPoint::InfoFlags flags;
-        Tool tool;
+        Tool tool = UNKNOWN_TOOL;
     };
-    QHash<int, Contact> m_contacts;  // The key is a tracking id for type A, slot number for type B.
-    QHash<int, Contact> m_lastContacts;
+
+    // Small map from slot number (type B) or tracking id (type A) to contact. The storage is reserved
+    // once, type B slots are indexed directly, so steady state touch processing doesn't allocate.
+    class ContactSlots
+    {
+    public:
+        void reset(int capacity, bool slotted);
+        void clear();
+        void swap(ContactSlots &other);
+        void catchUp(ContactSlots &last);
+        bool isSlotted() const { return m_slotted; }
+
+        Contact &operator[](int key);
+        const Contact *find(int key) const;
+        bool contains(int key) const { return find(key) != nullptr; }
+        Contact value(int key) const;
+        void insert(int key, const Contact &contact) { (*this)[key] = contact; }
+        void remove(int key);
+        void removeAt(int index);
+
+        int count() const { return int(m_keys.size()); }
+        bool isEmpty() const { return m_keys.empty(); }
+        int keyAt(int index) const { return m_keys[index]; }
+        Contact &at(int index) { return m_contacts[index]; }
+        const Contact &at(int index) const { return m_contacts[index]; }
+
+    private:
+        int indexOf(int key) const;
+
+        std::vector<int> m_keys;
+        std::vector<Contact> m_contacts;
+        std::vector<char> m_written;  // slotted only, the slots handed out by operator[] this frame
+        bool m_slotted = false;
+    };
+
+    ContactSlots m_contacts;  // The key is a tracking id for type A, slot number for type B.
+    ContactSlots m_lastContacts;
     Contact m_currentData;
     int m_currentSlot;
 
     double m_timeStamp;
     double m_lastTimeStamp;
 
-    int findClosestContact(const QHash<int, Contact> &contacts, int x, int y, int *dist);
+    void initContactSlots();
+    int findClosestContact(const ContactSlots &contacts, int x, int y, int *dist);
+    QWindowSystemInterface::TouchPoint &nextTouchPoint();
+    static void setRawPosition(QWindowSystemInterface::TouchPoint &tp, const QPointF &pos);
     virtual void addTouchPoint(const Contact &contact, Qt::TouchPointStates *combinedStates);
+    void processSynReport(const input_event *data);
     void reportPoints();
     void loadMultiScreenMappings();
 
@@ -106,6 +169,7 @@ public:
     int hw_range_y_max;
     int hw_pressure_min;
     int hw_pressure_max;
+    int hw_slot_count;
     QString hw_name;
     QString deviceNode;
     bool m_forceToActiveWindow;
@@ -130,6 +194,11 @@ public:
     // When filtering is enabled, protect the access to current and last
     // timeStamp and touchPoints, as these are being read on the gui thread.
     QMutex m_mutex;
+
+    // Scratch space for assignIds()
+    ContactSlots m_assignCandidates;
+    ContactSlots m_assignPending;
+    ContactSlots m_assignResult;
 };
 
 QT_END_NAMESPACE
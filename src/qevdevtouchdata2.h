@@ -63,11 +63,16 @@ public:
 
 
     QPointF transformTouchPoint(const QPointF &p, bool up);
-    void processInputEvent(input_event *data) override;
     void addTouchPoint(const Contact &contact, Qt::TouchPointStates *combinedStates) override;
+    void penLifted() override;
 private:
+    void penContact(const Contact &contact, const QPoint &pos);
+
     FBInkState* fbink_state;
     KoboFbScreen * koboFbScreen;
+    bool liftFrameTransformed;
+    bool inkStroke = false;
+    QPoint inkPoint;
 };
 
 QT_END_NAMESPACE
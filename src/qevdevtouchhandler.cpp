@@ -46,12 +46,16 @@
 #include <QGuiApplication>
 #include <QHash>
 #include <QLoggingCategory>
-#include <QSocketNotifier>
 #include <QStringList>
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QTouchDevice>
+#include <QVarLengthArray>
 
+#include "koboinputthread.h"
 #include "qevdevtouchdata.h"
 #include "qevdevtouchdata2.h"
+#include "qevdevtouchrecorder.h"
 
 QT_BEGIN_NAMESPACE
 
@@ -66,8 +70,19 @@ static inline bool testBit(long bit, const long *array)
 }
 
 QEvdevTouchScreenHandler::QEvdevTouchScreenHandler(const QString &device, const QString &spec,
-                                                   QObject *parent, KoboFbScreen *koboFbScreen)
-    : QObject(parent), m_notify(nullptr), m_fd(-1), d(nullptr), m_device(nullptr)
+                                                   KoboInputThread *inputThread, QObject *parent,
+                                                   KoboFbScreen *koboFbScreen)
+    : QObject(parent),
+      m_inputThread(inputThread),
+      m_fd(-1),
+      d(nullptr),
+      m_device(nullptr),
+      m_syncDropped(false),
+      m_droppedFrames(0),
+      m_recorder(nullptr),
+      m_coalesceTimer(nullptr),
+      m_hasCoalescedPoints(false),
+      m_latency(koboFbScreen ? koboFbScreen->latencyTracker() : nullptr)
 {
     setObjectName(QLatin1String("Evdev Touch Handler"));
 
@@ -82,6 +97,10 @@ QEvdevTouchScreenHandler::QEvdevTouchScreenHandler(const QString &device, const
     int hw_range_y_max_overwrite = 0;
     QRect screenRect;
     int screenrotation = 0;
+    QString recordPath;
+    QString replayPath;
+    QString dumpPath;
+    int coalesceMs = 0;
     for (int i = 0; i < args.count(); ++i)
     {
         if (args.at(i).startsWith(QLatin1String("screenwidth")))
@@ -150,21 +169,49 @@ QEvdevTouchScreenHandler::QEvdevTouchScreenHandler(const QString &device, const
         {
             legacytouchhandler = true;
         }
+        else if (args.at(i).startsWith(QLatin1String("touchrecord=")))
+        {
+            recordPath = args.at(i).section(QLatin1Char('='), 1, 1);
+        }
+        else if (args.at(i).startsWith(QLatin1String("touchreplay=")))
+        {
+            replayPath = args.at(i).section(QLatin1Char('='), 1, 1);
+        }
+        else if (args.at(i).startsWith(QLatin1String("touchdump=")))
+        {
+            dumpPath = args.at(i).section(QLatin1Char('='), 1, 1);
+        }
+        else if (args.at(i).startsWith(QLatin1String("touchcoalesce=")))
+        {
+            coalesceMs = args.at(i).section(QLatin1Char('='), 1, 1).toInt();
+        }
     }
 
-    qCDebug(qLcEvdevTouch2, "evdevtouch: Using device %ls", qUtf16Printable(device));
-
-    m_fd = QT_OPEN(device.toLocal8Bit().constData(), O_RDONLY | O_NDELAY, 0);
+    if (!recordPath.isEmpty() || !replayPath.isEmpty() || !dumpPath.isEmpty())
+        m_recorder = new QEvdevTouchRecorder;
 
-    if (m_fd >= 0)
+    if (!replayPath.isEmpty())
     {
-        m_notify = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
-        connect(m_notify, &QSocketNotifier::activated, this, &QEvdevTouchScreenHandler::readData);
+        // Nothing to open, the device properties come from the recording
+        qCDebug(qLcEvdevTouch2, "evdevtouch: Replaying %ls", qUtf16Printable(replayPath));
+        if (!m_recorder->loadReplay(replayPath))
+            return;
     }
     else
     {
-        qDebug("evdevtouch: Cannot open input device %ls", qUtf16Printable(device));
-        return;
+        qCDebug(qLcEvdevTouch2, "evdevtouch: Using device %ls", qUtf16Printable(device));
+
+        m_fd = QT_OPEN(device.toLocal8Bit().constData(), O_RDONLY | O_NDELAY, 0);
+
+        if (m_fd >= 0)
+        {
+            m_inputThread->addFd(m_fd, [this] { readData(); });
+        }
+        else
+        {
+            qDebug("evdevtouch: Cannot open input device %ls", qUtf16Printable(device));
+            return;
+        }
     }
 
 
@@ -176,15 +223,82 @@ QEvdevTouchScreenHandler::QEvdevTouchScreenHandler(const QString &device, const
     d->setScreenGeometry(screenRect);
     qCDebug(qLcEvdevTouch2, "evdevtouch: setting screen rect %d %d", screenRect.width(), screenRect.height());
 
-    long absbits[NUM_LONGS(ABS_CNT)];
-    if (ioctl(m_fd, EVIOCGBIT(EV_ABS, sizeof(absbits)), absbits) >= 0)
+    input_absinfo absInfo;
+    memset(&absInfo, 0, sizeof(input_absinfo));
+    bool has_x_range = false, has_y_range = false;
+
+    if (m_fd < 0)
     {
-        d->m_typeB = testBit(ABS_MT_SLOT, absbits);
-        d->m_singleTouch = !testBit(ABS_MT_POSITION_X, absbits);
+        // Replaying, there is no device to query
+        m_recorder->applyHeader(d);
+        if (hw_range_x_max_overwrite > 0)
+            d->hw_range_x_max = hw_range_x_max_overwrite;
+        if (hw_range_y_max_overwrite > 0)
+            d->hw_range_y_max = hw_range_y_max_overwrite;
+        has_x_range = has_y_range = true;
+    }
+    else
+    {
+        long absbits[NUM_LONGS(ABS_CNT)];
+        if (ioctl(m_fd, EVIOCGBIT(EV_ABS, sizeof(absbits)), absbits) >= 0)
+        {
+            d->m_typeB = testBit(ABS_MT_SLOT, absbits);
+            d->m_singleTouch = !testBit(ABS_MT_POSITION_X, absbits);
+        }
+        long keybits[NUM_LONGS(KEY_CNT)];
+        if (ioctl(m_fd, EVIOCGBIT(EV_KEY, sizeof(keybits)), keybits) >= 0)
+            d->m_btnTool = testBit(BTN_TOOL_FINGER, keybits);
+
+        if (ioctl(m_fd, EVIOCGABS((d->m_singleTouch ? ABS_X : ABS_MT_POSITION_X)), &absInfo) >= 0)
+        {
+            qCDebug(qLcEvdevTouch2, "evdevtouch: %ls: min X: %d max X: %d", qUtf16Printable(device),
+                    absInfo.minimum, absInfo.maximum);
+            d->hw_range_x_min = absInfo.minimum;
+            d->hw_range_x_max = hw_range_x_max_overwrite > 0 ? hw_range_x_max_overwrite : absInfo.maximum;
+            qCDebug(qLcEvdevTouch2, "evdevtouch: overwriting touch x max: %d", hw_range_x_max_overwrite);
+            has_x_range = true;
+        }
+
+        if (ioctl(m_fd, EVIOCGABS((d->m_singleTouch ? ABS_Y : ABS_MT_POSITION_Y)), &absInfo) >= 0)
+        {
+            qCDebug(qLcEvdevTouch2, "evdevtouch: %ls: min Y: %d max Y: %d", qUtf16Printable(device),
+                    absInfo.minimum, absInfo.maximum);
+            d->hw_range_y_min = absInfo.minimum;
+            d->hw_range_y_max = hw_range_y_max_overwrite > 0 ? hw_range_y_max_overwrite : absInfo.maximum;
+            qCDebug(qLcEvdevTouch2, "evdevtouch: overwriting touch y max: %d", hw_range_y_max_overwrite);
+            has_y_range = true;
+        }
+
+        if (d->m_typeB && ioctl(m_fd, EVIOCGABS(ABS_MT_SLOT), &absInfo) >= 0)
+        {
+            qCDebug(qLcEvdevTouch2, "evdevtouch: %ls: slots: %d", qUtf16Printable(device), absInfo.maximum + 1);
+            d->hw_slot_count = absInfo.maximum + 1;
+        }
+
+        if (ioctl(m_fd, EVIOCGABS(ABS_PRESSURE), &absInfo) >= 0)
+        {
+            qCDebug(qLcEvdevTouch2, "evdevtouch: %ls: min pressure: %d max pressure: %d",
+                    qUtf16Printable(device), absInfo.minimum, absInfo.maximum);
+            if (absInfo.maximum > absInfo.minimum)
+            {
+                d->hw_pressure_min = absInfo.minimum;
+                d->hw_pressure_max = absInfo.maximum;
+            }
+        }
+
+        char name[1024];
+        if (ioctl(m_fd, EVIOCGNAME(sizeof(name) - 1), name) >= 0)
+        {
+            d->hw_name = QString::fromLocal8Bit(name);
+            qCDebug(qLcEvdevTouch2, "evdevtouch: %ls: device name: %s", qUtf16Printable(device), name);
+        }
+
+        bool grabSuccess = !ioctl(m_fd, EVIOCGRAB, (void *)1);
+        if (grabSuccess)
+            ioctl(m_fd, EVIOCGRAB, (void *)0);
+        else
+            qDebug("evdevtouch: The device is grabbed by another process. No events will be read.");
     }
-    long keybits[NUM_LONGS(KEY_CNT)];
-    if (ioctl(m_fd, EVIOCGBIT(EV_KEY, sizeof(keybits)), keybits) >= 0)
-        d->m_btnTool = testBit(BTN_TOOL_FINGER, keybits);
 
     d->deviceNode = device;
     qCDebug(qLcEvdevTouch2, "evdevtouch: %ls: Protocol type %c (%s), filtered=%s",
@@ -193,43 +307,11 @@ QEvdevTouchScreenHandler::QEvdevTouchScreenHandler(const QString &device, const
     if (d->m_filtered)
         qCDebug(qLcEvdevTouch2, " - prediction=%d", d->m_prediction);
 
-    input_absinfo absInfo;
-    memset(&absInfo, 0, sizeof(input_absinfo));
-    bool has_x_range = false, has_y_range = false;
-
-    if (ioctl(m_fd, EVIOCGABS((d->m_singleTouch ? ABS_X : ABS_MT_POSITION_X)), &absInfo) >= 0)
-    {
-        qCDebug(qLcEvdevTouch2, "evdevtouch: %ls: min X: %d max X: %d", qUtf16Printable(device),
-                absInfo.minimum, absInfo.maximum);
-        d->hw_range_x_min = absInfo.minimum;
-        d->hw_range_x_max = hw_range_x_max_overwrite > 0 ? hw_range_x_max_overwrite : absInfo.maximum;
-        qCDebug(qLcEvdevTouch2, "evdevtouch: overwriting touch x max: %d", hw_range_x_max_overwrite);
-        has_x_range = true;
-    }
-
-    if (ioctl(m_fd, EVIOCGABS((d->m_singleTouch ? ABS_Y : ABS_MT_POSITION_Y)), &absInfo) >= 0)
-    {
-        qCDebug(qLcEvdevTouch2, "evdevtouch: %ls: min Y: %d max Y: %d", qUtf16Printable(device),
-                absInfo.minimum, absInfo.maximum);
-        d->hw_range_y_min = absInfo.minimum;
-        d->hw_range_y_max = hw_range_y_max_overwrite > 0 ? hw_range_y_max_overwrite : absInfo.maximum;
-        qCDebug(qLcEvdevTouch2, "evdevtouch: overwriting touch y max: %d", hw_range_y_max_overwrite);
-        has_y_range = true;
-    }
-
     if (!has_x_range || !has_y_range)
         qDebug("evdevtouch: %ls: Invalid ABS limits, behavior unspecified", qUtf16Printable(device));
 
-    if (ioctl(m_fd, EVIOCGABS(ABS_PRESSURE), &absInfo) >= 0)
-    {
-        qCDebug(qLcEvdevTouch2, "evdevtouch: %ls: min pressure: %d max pressure: %d", qUtf16Printable(device),
-                absInfo.minimum, absInfo.maximum);
-        if (absInfo.maximum > absInfo.minimum)
-        {
-            d->hw_pressure_min = absInfo.minimum;
-            d->hw_pressure_max = absInfo.maximum;
-        }
-    }
+    d->initContactSlots();
+    d->selectDecoder();
 
     d->m_swapXY = swapxy;
     d->m_invertX = invertx;
@@ -239,28 +321,42 @@ QEvdevTouchScreenHandler::QEvdevTouchScreenHandler(const QString &device, const
     else
         d->m_rotate = 0;
 
-    char name[1024];
-    if (ioctl(m_fd, EVIOCGNAME(sizeof(name) - 1), name) >= 0)
+    if (!recordPath.isEmpty() && replayPath.isEmpty())
+        m_recorder->startRecording(recordPath, d);
+    if (!dumpPath.isEmpty())
+        m_recorder->startPointDump(dumpPath);
+
+    // The filter already paces delivery to the window updates
+    if (coalesceMs > 0 && !d->m_filtered)
     {
-        d->hw_name = QString::fromLocal8Bit(name);
-        qCDebug(qLcEvdevTouch2, "evdevtouch: %ls: device name: %s", qUtf16Printable(device), name);
+        m_coalesceTimer = new QTimer(this);
+        m_coalesceTimer->setSingleShot(true);
+        m_coalesceTimer->setInterval(coalesceMs);
+        connect(m_coalesceTimer, &QTimer::timeout, this, &QEvdevTouchScreenHandler::flushCoalescedPoints);
+        if (koboFbScreen)
+            connect(koboFbScreen, &KoboFbScreen::refreshIdle, this,
+                    &QEvdevTouchScreenHandler::flushCoalescedPoints);
+        qCDebug(qLcEvdevTouch2, "evdevtouch: %ls: coalescing moves within %d ms", qUtf16Printable(device),
+                coalesceMs);
     }
 
-    bool grabSuccess = !ioctl(m_fd, EVIOCGRAB, (void *)1);
-    if (grabSuccess)
-        ioctl(m_fd, EVIOCGRAB, (void *)0);
-    else
-        qDebug("evdevtouch: The device is grabbed by another process. No events will be read.");
-
     registerTouchDevice();
+
+    // Runs once this thread's event loop is up
+    if (!replayPath.isEmpty())
+        QTimer::singleShot(0, this, &QEvdevTouchScreenHandler::replayRecording);
 }
 
 QEvdevTouchScreenHandler::~QEvdevTouchScreenHandler()
 {
     if (m_fd >= 0)
+    {
+        m_inputThread->removeFd(m_fd);
         QT_CLOSE(m_fd);
+    }
 
     delete d;
+    delete m_recorder;
 
     unregisterTouchDevice();
 }
@@ -275,53 +371,260 @@ QTouchDevice *QEvdevTouchScreenHandler::touchDevice() const
     return m_device;
 }
 
-void QEvdevTouchScreenHandler::readData()
+quint32 QEvdevTouchScreenHandler::droppedFrameCount() const
 {
-    ::input_event buffer[32];
-    int events = 0;
+    return m_droppedFrames.loadRelaxed();
+}
 
-    int n = 0;
+void QEvdevTouchScreenHandler::readData()
+{
+    // Drain everything that is queued, so the kernel buffer can't overflow while this thread is busy
     for (;;)
     {
-        events = QT_READ(m_fd, reinterpret_cast<char *>(buffer) + n, sizeof(buffer) - n);
+        ssize_t events = QT_READ(m_fd, reinterpret_cast<char *>(m_readBuffer), sizeof(m_readBuffer));
         if (events <= 0)
-            goto err;
-        n += events;
-        if (n % sizeof(::input_event) == 0)
-            break;
+        {
+            if (!events)
+            {
+                qDebug("evdevtouch: Got EOF from input device");
+                return;
+            }
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+                return;
+
+            qDebug("evdevtouch: Could not read from input device");
+            if (errno == ENODEV)
+            {  // device got disconnected -> stop reading
+                m_inputThread->removeFd(m_fd);
+
+                QT_CLOSE(m_fd);
+                m_fd = -1;
+
+                unregisterTouchDevice();
+            }
+            return;
+        }
+
+        // evdev only ever returns whole events
+        const int n = events / sizeof(::input_event);
+        if (m_recorder && m_recorder->isRecording())
+            m_recorder->record(m_readBuffer, n);
+
+        for (int i = 0; i < n; ++i)
+            processEvent(&m_readBuffer[i]);
     }
+}
 
-    n /= sizeof(::input_event);
+bool QEvdevTouchScreenHandler::coalesceTouchPoints(QList<QWindowSystemInterface::TouchPoint> &points)
+{
+    if (!m_coalesceTimer)
+        return false;
 
-    for (int i = 0; i < n; ++i)
-        d->processInputEvent(&buffer[i]);
+    bool moveOnly = true;
+    for (QWindowSystemInterface::TouchPoint &tp : points)
+    {
+        if (tp.state != Qt::TouchPointMoved && tp.state != Qt::TouchPointStationary)
+            moveOnly = false;
 
-    return;
+        // A point that moved in a held back frame still moved as far as the application is concerned
+        if (m_hasCoalescedPoints && tp.state == Qt::TouchPointStationary)
+        {
+            for (const QWindowSystemInterface::TouchPoint &held : qAsConst(m_coalescedPoints))
+            {
+                if (held.id == tp.id && held.state == Qt::TouchPointMoved)
+                {
+                    tp.state = Qt::TouchPointMoved;
+                    break;
+                }
+            }
+        }
+    }
 
-err:
-    if (!events)
+    // Presses and releases go out right away, they carry the latest position of every point
+    if (!moveOnly)
     {
-        qDebug("evdevtouch: Got EOF from input device");
+        m_hasCoalescedPoints = false;
+        m_coalesceTimer->stop();
+        return false;
+    }
+
+    // The first move after a quiet period isn't delayed, the ones following it are merged
+    if (!m_coalesceTimer->isActive())
+    {
+        m_coalesceTimer->start();
+        return false;
+    }
+
+    m_coalescedPoints = points;
+    m_hasCoalescedPoints = true;
+    return true;
+}
+
+void QEvdevTouchScreenHandler::flushCoalescedPoints()
+{
+    if (!m_hasCoalescedPoints)
+        return;
+
+    m_hasCoalescedPoints = false;
+    QWindowSystemInterface::handleTouchEvent(nullptr, m_device, m_coalescedPoints);
+    m_coalesceTimer->start();
+}
+
+void QEvdevTouchScreenHandler::replayRecording()
+{
+    // Feed the whole recording through the decoder as fast as it goes, which doubles as a benchmark
+    std::vector<::input_event> events = m_recorder->replayEvents();
+
+    QElapsedTimer total;
+    QElapsedTimer frame;
+    qint64 slowestFrame = 0;
+    int frames = 0;
+
+    total.start();
+    frame.start();
+    for (::input_event &event : events)
+    {
+        processEvent(&event);
+        if (event.type == EV_SYN && event.code == SYN_REPORT)
+        {
+            slowestFrame = qMax(slowestFrame, frame.nsecsElapsed());
+            ++frames;
+            frame.restart();
+        }
+    }
+    const qint64 elapsed = qMax<qint64>(total.nsecsElapsed(), 1);
+
+    // Complete on disk while the application is still running
+    m_recorder->stopPointDump();
+
+    qDebug("evdevtouch: Replayed %zu events in %d frames in %.3f ms: %.0f events/s, %.2f us per frame, "
+           "slowest frame %.2f us",
+           events.size(), frames, elapsed / 1e6, events.size() * 1e9 / elapsed,
+           frames ? elapsed / 1e3 / frames : 0.0, slowestFrame / 1e3);
+}
+
+void QEvdevTouchScreenHandler::processEvent(::input_event *event)
+{
+    if (event->type == EV_SYN && event->code == SYN_DROPPED)
+    {
+        m_syncDropped = true;
+        ++m_droppedFrames;
         return;
     }
-    else if (events < 0)
+
+    if (m_syncDropped)
     {
-        if (errno != EINTR && errno != EAGAIN)
+        if (event->type == EV_SYN && event->code == SYN_REPORT)
         {
-            qDebug("evdevtouch: Could not read from input device");
-            if (errno == ENODEV)
-            {  // device got disconnected -> stop reading
-                delete m_notify;
-                m_notify = nullptr;
+            m_syncDropped = false;
+            resyncState(event);
+        }
+        return;
+    }
 
-                QT_CLOSE(m_fd);
-                m_fd = -1;
+    d->processInputEvent(event);
+}
 
-                unregisterTouchDevice();
-            }
+void QEvdevTouchScreenHandler::resyncState(const ::input_event *syn)
+{
+    qCDebug(qLcEvdevTouch2, "evdevtouch: %ls: SYN_DROPPED, resyncing (%u dropped frames so far)",
+            qUtf16Printable(d->deviceNode), m_droppedFrames.loadRelaxed());
+
+    // A replay has no device to ask, the recording carries on from the state it built up
+    if (m_fd < 0)
+        return;
+
+    input_absinfo absInfo;
+    memset(&absInfo, 0, sizeof(input_absinfo));
+
+    if (d->m_typeB)
+    {
+        const int slots = d->hw_slot_count;
+        if (slots <= 0)
+            return;
+
+        // EVIOCGMTSLOTS takes the axis code followed by room for one value per slot
+        auto querySlots = [this, slots](int code, QVarLengthArray<int32_t, 33> &values) {
+            values.resize(slots + 1);
+            values[0] = code;
+            return ioctl(m_fd, EVIOCGMTSLOTS(values.size() * sizeof(int32_t)), values.data()) >= 0;
+        };
+
+        QVarLengthArray<int32_t, 33> trackingIds, xs, ys, pressures;
+        if (!querySlots(ABS_MT_TRACKING_ID, trackingIds) || !querySlots(ABS_MT_POSITION_X, xs) ||
+            !querySlots(ABS_MT_POSITION_Y, ys))
+        {
+            qDebug("evdevtouch: Failed to query slot state after SYN_DROPPED");
             return;
         }
+        const bool hasPressure = querySlots(ABS_MT_PRESSURE, pressures);
+
+        for (int slot = 0; slot < slots; ++slot)
+        {
+            const int trackingId = trackingIds[slot + 1];
+            const bool known = d->m_contacts.contains(slot) && d->m_contacts.value(slot).state;
+            if (trackingId == -1 && !known)
+                continue;
+
+            QEvdevTouchScreenData::Contact &contact = d->m_contacts[slot];
+            if (trackingId == -1)
+            {
+                contact.state = Qt::TouchPointReleased;
+                continue;
+            }
+
+            const int x = qBound(d->hw_range_x_min, xs[slot + 1], d->hw_range_x_max);
+            const int y = qBound(d->hw_range_y_min, ys[slot + 1], d->hw_range_y_max);
+            if (!known || contact.trackingId != trackingId)
+            {
+                contact.state = Qt::TouchPointPressed;
+                contact.trackingId = trackingId;
+            }
+            else if (contact.x != x || contact.y != y)
+            {
+                contact.state = Qt::TouchPointMoved;
+            }
+            contact.x = x;
+            contact.y = y;
+            if (hasPressure)
+                contact.pressure = qBound(d->hw_pressure_min, pressures[slot + 1], d->hw_pressure_max);
+        }
+
+        if (ioctl(m_fd, EVIOCGABS(ABS_MT_SLOT), &absInfo) >= 0)
+            d->m_currentSlot = absInfo.value;
+    }
+    else if (d->m_singleTouch)
+    {
+        QEvdevTouchScreenData::Contact &contact = d->m_contacts[d->m_currentSlot];
+        if (ioctl(m_fd, EVIOCGABS(ABS_X), &absInfo) >= 0)
+            contact.x = qBound(d->hw_range_x_min, absInfo.value, d->hw_range_x_max);
+        if (ioctl(m_fd, EVIOCGABS(ABS_Y), &absInfo) >= 0)
+            contact.y = qBound(d->hw_range_y_min, absInfo.value, d->hw_range_y_max);
+
+        long keys[NUM_LONGS(KEY_CNT)];
+        memset(keys, 0, sizeof(keys));
+        if (ioctl(m_fd, EVIOCGKEY(sizeof(keys)), keys) >= 0)
+        {
+            const bool down = testBit(BTN_TOUCH, keys);
+            if (down && (!contact.state || contact.state == Qt::TouchPointReleased))
+                contact.state = Qt::TouchPointPressed;
+            else if (!down && contact.state && contact.state != Qt::TouchPointReleased)
+                contact.state = Qt::TouchPointReleased;
+        }
     }
+    else
+    {
+        // Protocol A frames are self contained: drop the broken one, the next frame carries the full state
+        d->m_contacts.clear();
+        d->m_currentData = QEvdevTouchScreenData::Contact();
+        return;
+    }
+
+    // Report the queried state as a frame of its own
+    ::input_event report = *syn;
+    d->processInputEvent(&report);
 }
 
 void QEvdevTouchScreenHandler::registerTouchDevice()
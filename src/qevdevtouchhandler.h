@@ -52,9 +52,12 @@
 // We mean it.
 //
 
+#include <linux/input.h>
+
 #include <QtCore/private/qthread_p.h>
 #include <qpa/qwindowsysteminterface.h>
 
+#include <QAtomicInteger>
 #include <QList>
 #include <QObject>
 #include <QString>
@@ -63,8 +66,11 @@
 
 QT_BEGIN_NAMESPACE
 
-class QSocketNotifier;
+class QTimer;
+class KoboInputThread;
+class KoboLatencyTracker;
 class QEvdevTouchScreenData;
+class QEvdevTouchRecorder;
 
 class QEvdevTouchScreenHandler : public QObject
 {
@@ -72,7 +78,8 @@ class QEvdevTouchScreenHandler : public QObject
 
 public:
     explicit QEvdevTouchScreenHandler(const QString &device, const QString &spec,
-                                      QObject *parent, KoboFbScreen *koboFbScreen);
+                                      KoboInputThread *inputThread, QObject *parent,
+                                      KoboFbScreen *koboFbScreen);
     ~QEvdevTouchScreenHandler();
 
     QTouchDevice *touchDevice() const;
@@ -81,20 +88,49 @@ public:
 
     void readData();
 
+    // SYN_DROPPED seen so far, read from any thread
+    quint32 droppedFrameCount() const;
+
+    bool coalesceTouchPoints(QList<QWindowSystemInterface::TouchPoint> &points);
+
+    void flushCoalescedPoints();
+
 signals:
     void touchPointsUpdated();
 
 private:
     friend class QEvdevTouchScreenData;
-    friend class QEvdevTouchScreenHandlerThread;
+    friend class QEvdevTouchScreenHandlerProxy;
 
     void registerTouchDevice();
     void unregisterTouchDevice();
 
-    QSocketNotifier *m_notify;
+    void processEvent(::input_event *event);
+    void resyncState(const ::input_event *syn);
+    void replayRecording();
+
+    KoboInputThread *m_inputThread;
     int m_fd;
     QEvdevTouchScreenData *d;
     QTouchDevice *m_device;
+
+    // Reused for every read, big enough to empty the kernel queue of a 240 Hz digitizer in a few reads
+    ::input_event m_readBuffer[256];
+
+    // Set on SYN_DROPPED, events are discarded until the next SYN_REPORT and the state is queried instead
+    bool m_syncDropped;
+    QAtomicInteger<quint32> m_droppedFrames;
+
+    // Set when recording, replaying or dumping touch points was requested
+    QEvdevTouchRecorder *m_recorder;
+
+    // Move-only frames within the interval are merged into one event, null when not coalescing
+    QTimer *m_coalesceTimer;
+    QList<QWindowSystemInterface::TouchPoint> m_coalescedPoints;
+    bool m_hasCoalescedPoints;
+
+    // Null unless the screen tracks touch latency
+    KoboLatencyTracker *m_latency;
 };
 
 QT_END_NAMESPACE
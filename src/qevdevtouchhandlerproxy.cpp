@@ -38,7 +38,9 @@
 **
 ****************************************************************************/
 
-#include "qevdevtouchhandlerthread.h"
+#include "qevdevtouchhandlerproxy.h"
+
+#include "koboinputthread.h"
 
 #include <linux/input.h>
 #include <math.h>
@@ -46,63 +48,61 @@
 #include <QGuiApplication>
 #include <QHash>
 #include <QLoggingCategory>
-#include <QSocketNotifier>
 #include <QStringList>
 #include <QTouchDevice>
 
 QT_BEGIN_NAMESPACE
 
-QEvdevTouchScreenHandlerThread::QEvdevTouchScreenHandlerThread(const QString &device, const QString &spec,
-                                                               QObject *parent, KoboFbScreen *koboFbScreen) :
+QEvdevTouchScreenHandlerProxy::QEvdevTouchScreenHandlerProxy(const QString &device, const QString &spec,
+                                                             KoboInputThread *inputThread, QObject *parent,
+                                                             KoboFbScreen *koboFbScreen)
+    : QObject(parent),
       m_device(device),
       m_spec(spec),
+      m_inputThread(inputThread),
       m_handler(nullptr),
       m_touchDeviceRegistered(false),
       m_touchUpdatePending(false),
       m_filterWindow(nullptr),
       m_touchRate(-1),
-    koboFbScreen(koboFbScreen)
-
-{
-    setParent(parent);
-    start();
-}
-
-QEvdevTouchScreenHandlerThread::~QEvdevTouchScreenHandlerThread()
-{
-    quit();
-    wait();
-}
-
-void QEvdevTouchScreenHandlerThread::run()
+      koboFbScreen(koboFbScreen)
 {
-    m_handler = new QEvdevTouchScreenHandler(m_device, m_spec, nullptr, koboFbScreen);
+    // The handler's fd, timers and signals all belong to the input thread
+    m_inputThread->runInThread([this, koboFbScreen] {
+        m_handler = new QEvdevTouchScreenHandler(m_device, m_spec, m_inputThread, nullptr, koboFbScreen);
+    });
 
     if (m_handler->isFiltered())
         connect(m_handler, &QEvdevTouchScreenHandler::touchPointsUpdated, this,
-                &QEvdevTouchScreenHandlerThread::scheduleTouchPointUpdate);
+                &QEvdevTouchScreenHandlerProxy::scheduleTouchPointUpdate);
 
-    // Report the registration to the parent thread by invoking the method asynchronously
+    // Report the registration once the caller had a chance to connect to touchDeviceRegistered
     QMetaObject::invokeMethod(this, "notifyTouchDeviceRegistered", Qt::QueuedConnection);
+}
 
-    exec();
-
-    delete m_handler;
+QEvdevTouchScreenHandlerProxy::~QEvdevTouchScreenHandlerProxy()
+{
+    m_inputThread->runInThread([this] { delete m_handler; });
     m_handler = nullptr;
 }
 
-bool QEvdevTouchScreenHandlerThread::isTouchDeviceRegistered() const
+bool QEvdevTouchScreenHandlerProxy::isTouchDeviceRegistered() const
 {
     return m_touchDeviceRegistered;
 }
 
-void QEvdevTouchScreenHandlerThread::notifyTouchDeviceRegistered()
+quint32 QEvdevTouchScreenHandlerProxy::droppedFrameCount() const
+{
+    return m_handler ? m_handler->droppedFrameCount() : 0;
+}
+
+void QEvdevTouchScreenHandlerProxy::notifyTouchDeviceRegistered()
 {
     m_touchDeviceRegistered = true;
     emit touchDeviceRegistered();
 }
 
-void QEvdevTouchScreenHandlerThread::scheduleTouchPointUpdate()
+void QEvdevTouchScreenHandlerProxy::scheduleTouchPointUpdate()
 {
     QWindow *window = QGuiApplication::focusWindow();
     if (window != m_filterWindow)
@@ -120,7 +120,7 @@ void QEvdevTouchScreenHandlerThread::scheduleTouchPointUpdate()
     }
 }
 
-bool QEvdevTouchScreenHandlerThread::eventFilter(QObject *object, QEvent *event)
+bool QEvdevTouchScreenHandlerProxy::eventFilter(QObject *object, QEvent *event)
 {
     if (m_touchUpdatePending && object == m_filterWindow && event->type() == QEvent::UpdateRequest)
     {
@@ -130,7 +130,7 @@ bool QEvdevTouchScreenHandlerThread::eventFilter(QObject *object, QEvent *event)
     return false;
 }
 
-void QEvdevTouchScreenHandlerThread::filterAndSendTouchPoints()
+void QEvdevTouchScreenHandlerProxy::filterAndSendTouchPoints()
 {
     QRect winRect = m_handler->d->screenGeometry();
     if (winRect.isNull())
@@ -38,8 +38,8 @@
 **
 ****************************************************************************/
 
-#ifndef QEVDEVTOUCHHANDLERTHREAD_H
-#define QEVDEVTOUCHHANDLERTHREAD_H
+#ifndef QEVDEVTOUCHHANDLERPROXY_H
+#define QEVDEVTOUCHHANDLERPROXY_H
 
 //
 //  W A R N I N G
@@ -52,30 +52,33 @@
 // We mean it.
 //
 
-#include <QtCore/private/qthread_p.h>
 #include <qpa/qwindowsysteminterface.h>
 
 #include <QList>
 #include <QObject>
 #include <QString>
-#include <QThread>
 
 #include "qevdevtouchdata.h"
 #include "qevdevtouchhandler.h"
 
 QT_BEGIN_NAMESPACE
 
-class QEvdevTouchScreenHandlerThread : public QDaemonThread
+class KoboInputThread;
+
+// Lives in the GUI thread and owns a handler living in the shared input thread
+class QEvdevTouchScreenHandlerProxy : public QObject
 {
     Q_OBJECT
 public:
-    explicit QEvdevTouchScreenHandlerThread(const QString &device, const QString &spec,
-                                            QObject *parent, KoboFbScreen *koboFbScreen);
-    ~QEvdevTouchScreenHandlerThread();
-    void run() override;
+    explicit QEvdevTouchScreenHandlerProxy(const QString &device, const QString &spec,
+                                           KoboInputThread *inputThread, QObject *parent,
+                                           KoboFbScreen *koboFbScreen);
+    ~QEvdevTouchScreenHandlerProxy();
 
     bool isTouchDeviceRegistered() const;
 
+    quint32 droppedFrameCount() const;
+
     bool eventFilter(QObject *object, QEvent *event) override;
 
     void scheduleTouchPointUpdate();
@@ -91,6 +94,7 @@ private:
 
     QString m_device;
     QString m_spec;
+    KoboInputThread *m_inputThread;
     QEvdevTouchScreenHandler *m_handler;
     bool m_touchDeviceRegistered;
 
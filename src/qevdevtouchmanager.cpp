@@ -44,7 +44,8 @@
 #include <QLoggingCategory>
 #include <QStringList>
 
-#include "qevdevtouchhandlerthread.h"
+#include "kobostartuptrace.h"
+#include "qevdevtouchhandlerproxy.h"
 #include "qevdevtouchmanager_p.h"
 
 QT_BEGIN_NAMESPACE
@@ -53,9 +54,9 @@ Q_DECLARE_LOGGING_CATEGORY(qLcEvdevTouch)
 Q_DECLARE_LOGGING_CATEGORY(qLcEvdevTouch2)
 Q_DECLARE_LOGGING_CATEGORY(qLcEvdevTouch3)
 
-QEvdevTouchManager::QEvdevTouchManager(const QString &key, const QString &specification, QObject *parent,
-                                       KoboFbScreen *koboFbScreen)
-    : QObject(parent), koboFbScreen(koboFbScreen)
+QEvdevTouchManager::QEvdevTouchManager(const QString &key, const QString &specification,
+                                       KoboInputThread *inputThread, QObject *parent, KoboFbScreen *koboFbScreen)
+    : QObject(parent), m_inputThread(inputThread), koboFbScreen(koboFbScreen)
 {
     Q_UNUSED(key);
 
@@ -75,42 +76,58 @@ QEvdevTouchManager::QEvdevTouchManager(const QString &key, const QString &specif
 
     auto args = spec.splitRef(QLatin1Char(':'));
 
-    qCDebug(qLcEvdevTouch, "evdevtouch: Using device discovery");
-    if (auto deviceDiscovery = QDeviceDiscovery::create(
-            QDeviceDiscovery::Device_Touchpad | QDeviceDiscovery::Device_Touchscreen, this))
+    // A replayed recording stands in for the real devices
+    for (const QStringRef &arg : qAsConst(args))
     {
-        const QStringList devices = deviceDiscovery->scanConnectedDevices();
-
-        // Periodic scanning for reasons
-        // discovery = deviceDiscovery;
-        // QTimer* timer = new QTimer(this);
-        // timer->setInterval(1000);
-        // connect(timer, &QTimer::timeout, this, &QEvdevTouchManager::periodicScan);
-        // timer->start();
+        if (arg.startsWith(QLatin1String("touchreplay=")))
+            devicePaths.append(arg.mid(12).toString());
+    }
 
-        for (const QString &device : devices) {
-            addDevice(device);
+    if (devicePaths.isEmpty())
+    {
+        qCDebug(qLcEvdevTouch, "evdevtouch: Using device discovery");
+        KoboStartupTrace::Phase phase("touch device discovery");
+        if (auto deviceDiscovery = QDeviceDiscovery::create(
+                QDeviceDiscovery::Device_Touchpad | QDeviceDiscovery::Device_Touchscreen, this))
+        {
+            const QStringList devices = deviceDiscovery->scanConnectedDevices();
+
+            // Periodic scanning for reasons
+            // discovery = deviceDiscovery;
+            // QTimer* timer = new QTimer(this);
+            // timer->setInterval(1000);
+            // connect(timer, &QTimer::timeout, this, &QEvdevTouchManager::periodicScan);
+            // timer->start();
+
+            for (const QString &device : devices) {
+                addDevice(device);
+            }
+
+            connect(deviceDiscovery, &QDeviceDiscovery::deviceDetected, this, &QEvdevTouchManager::addDevice);
+            connect(deviceDiscovery, &QDeviceDiscovery::deviceRemoved, this,
+                    &QEvdevTouchManager::removeDevice);
         }
-
-        connect(deviceDiscovery, &QDeviceDiscovery::deviceDetected, this, &QEvdevTouchManager::addDevice);
-        connect(deviceDiscovery, &QDeviceDiscovery::deviceRemoved, this,
-                &QEvdevTouchManager::removeDevice);
     }
 
     for (const QString &device : qAsConst(devicePaths))
         addDevice(device);
 }
 
-QEvdevTouchManager::~QEvdevTouchManager() {}
+QEvdevTouchManager::~QEvdevTouchManager()
+{
+    // The handlers are deleted on the input thread, which is stopped only after this
+    m_activeDevices.clear();
+}
 
 void QEvdevTouchManager::addDevice(const QString &deviceNode)
 {
     qCDebug(qLcEvdevTouch, "evdevtouch: Adding device at %ls", qUtf16Printable(deviceNode));
-    auto handler = std::unique_ptr<QEvdevTouchScreenHandlerThread>{
-        new QEvdevTouchScreenHandlerThread(deviceNode, m_spec, this, koboFbScreen)};
+    KoboStartupTrace::Phase phase("touch device");
+    auto handler = std::unique_ptr<QEvdevTouchScreenHandlerProxy>{
+        new QEvdevTouchScreenHandlerProxy(deviceNode, m_spec, m_inputThread, this, koboFbScreen)};
     if (handler)
     {
-        connect(handler.get(), &QEvdevTouchScreenHandlerThread::touchDeviceRegistered, this,
+        connect(handler.get(), &QEvdevTouchScreenHandlerProxy::touchDeviceRegistered, this,
                 &QEvdevTouchManager::updateInputDeviceCount);
         m_activeDevices.push_back({deviceNode, std::move(handler)});
     }
@@ -134,6 +151,14 @@ void QEvdevTouchManager::removeDevice(const QString &deviceNode)
     }
 }
 
+quint32 QEvdevTouchManager::droppedFrameCount() const
+{
+    quint32 count = 0;
+    for (const auto &device : m_activeDevices)
+        count += device.handler->droppedFrameCount();
+    return count;
+}
+
 void QEvdevTouchManager::updateInputDeviceCount()
 {
     int registeredTouchDevices = 0;
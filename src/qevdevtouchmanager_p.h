@@ -61,7 +61,8 @@
 
 QT_BEGIN_NAMESPACE
 
-class QEvdevTouchScreenHandlerThread;
+class QEvdevTouchScreenHandlerProxy;
+class KoboInputThread;
 
 class QEvdevTouchManager : public QObject
 {
@@ -69,19 +70,24 @@ public:
     struct Device
     {
         QString deviceNode;
-        std::unique_ptr<QEvdevTouchScreenHandlerThread> handler;
+        std::unique_ptr<QEvdevTouchScreenHandlerProxy> handler;
     };
 
-    QEvdevTouchManager(const QString &key, const QString &spec, QObject *parent, KoboFbScreen *koboFbScreen);
+    QEvdevTouchManager(const QString &key, const QString &spec, KoboInputThread *inputThread, QObject *parent,
+                       KoboFbScreen *koboFbScreen);
     ~QEvdevTouchManager();
 
     void addDevice(const QString &deviceNode);
     void removeDevice(const QString &deviceNode);
     void updateInputDeviceCount();
 
+    // SYN_DROPPED over all touch devices, the kernel queue overflowed before they were read
+    quint32 droppedFrameCount() const;
+
 private:
     QString m_spec;
     QStringList devicePaths;
+    KoboInputThread *m_inputThread;
     std::vector<Device> m_activeDevices;
     KoboFbScreen *koboFbScreen;
 };
@@ -0,0 +1,148 @@
+#include "qevdevtouchrecorder.h"
+
+#include <QDataStream>
+#include <QLoggingCategory>
+
+#include "qevdevtouchdata.h"
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(qLcEvdevTouch2)
+
+bool QEvdevTouchRecorder::startRecording(const QString &path, const QEvdevTouchScreenData *d)
+{
+    m_recordFile.setFileName(path);
+    if (!m_recordFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qDebug("evdevtouch: Cannot open %ls for recording", qUtf16Printable(path));
+        return false;
+    }
+
+    quint32 flags = 0;
+    if (d->m_typeB)
+        flags |= TypeB;
+    if (d->m_singleTouch)
+        flags |= SingleTouch;
+    if (d->m_btnTool)
+        flags |= BtnTool;
+
+    QDataStream stream(&m_recordFile);
+    stream << Magic << Version << flags << qint32(d->hw_range_x_min) << qint32(d->hw_range_x_max)
+           << qint32(d->hw_range_y_min) << qint32(d->hw_range_y_max) << qint32(d->hw_pressure_min)
+           << qint32(d->hw_pressure_max) << qint32(d->hw_slot_count) << d->hw_name;
+    m_recordFile.flush();
+
+    qCDebug(qLcEvdevTouch2, "evdevtouch: Recording %ls to %ls", qUtf16Printable(d->deviceNode),
+            qUtf16Printable(path));
+    return true;
+}
+
+void QEvdevTouchRecorder::record(const input_event *events, int count)
+{
+    QDataStream stream(&m_recordFile);
+    for (int i = 0; i < count; ++i)
+    {
+        const input_event &event = events[i];
+        stream << quint32(event.time.tv_sec) << quint32(event.time.tv_usec) << quint16(event.type)
+               << quint16(event.code) << qint32(event.value);
+    }
+
+    // Keep the capture usable if the application gets killed
+    m_recordFile.flush();
+}
+
+bool QEvdevTouchRecorder::loadReplay(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qDebug("evdevtouch: Cannot open recording %ls", qUtf16Printable(path));
+        return false;
+    }
+
+    QDataStream stream(&file);
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+    if (magic != Magic || version != Version)
+    {
+        qDebug("evdevtouch: %ls is not a touch recording", qUtf16Printable(path));
+        return false;
+    }
+
+    stream >> m_header.flags >> m_header.xMin >> m_header.xMax >> m_header.yMin >> m_header.yMax >>
+        m_header.pressureMin >> m_header.pressureMax >> m_header.slotCount >> m_header.name;
+
+    m_events.clear();
+    m_events.reserve((file.size() - file.pos()) / 16);
+    while (!stream.atEnd())
+    {
+        quint32 sec, usec;
+        quint16 type, code;
+        qint32 value;
+        stream >> sec >> usec >> type >> code >> value;
+        if (stream.status() != QDataStream::Ok)
+            break;
+
+        input_event event;
+        event.time.tv_sec = sec;
+        event.time.tv_usec = usec;
+        event.type = type;
+        event.code = code;
+        event.value = value;
+        m_events.push_back(event);
+    }
+
+    qCDebug(qLcEvdevTouch2, "evdevtouch: Loaded %zu events recorded from \"%ls\"", m_events.size(),
+            qUtf16Printable(m_header.name));
+    return true;
+}
+
+void QEvdevTouchRecorder::applyHeader(QEvdevTouchScreenData *d) const
+{
+    d->m_typeB = m_header.flags & TypeB;
+    d->m_singleTouch = m_header.flags & SingleTouch;
+    d->m_btnTool = m_header.flags & BtnTool;
+    d->hw_range_x_min = m_header.xMin;
+    d->hw_range_x_max = m_header.xMax;
+    d->hw_range_y_min = m_header.yMin;
+    d->hw_range_y_max = m_header.yMax;
+    d->hw_pressure_min = m_header.pressureMin;
+    d->hw_pressure_max = m_header.pressureMax;
+    d->hw_slot_count = m_header.slotCount;
+    d->hw_name = m_header.name;
+}
+
+bool QEvdevTouchRecorder::startPointDump(const QString &path)
+{
+    m_dumpFile.setFileName(path);
+    if (!m_dumpFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        qDebug("evdevtouch: Cannot open %ls for the touch point dump", qUtf16Printable(path));
+        return false;
+    }
+    return true;
+}
+
+void QEvdevTouchRecorder::dumpPoints(double timeStamp, const QList<QWindowSystemInterface::TouchPoint> &points)
+{
+    // One line per frame: timestamp, then id, state, normalized position and pressure of each point.
+    // Fixed precision so runs on different machines compare equal.
+    QByteArray line = QByteArray::number(timeStamp, 'f', 6);
+    for (const QWindowSystemInterface::TouchPoint &tp : points)
+    {
+        line += ' ';
+        line += QByteArray::number(tp.id);
+        line += ':';
+        line += QByteArray::number(int(tp.state));
+        line += ':';
+        line += QByteArray::number(tp.normalPosition.x(), 'f', 5);
+        line += ',';
+        line += QByteArray::number(tp.normalPosition.y(), 'f', 5);
+        line += ':';
+        line += QByteArray::number(tp.pressure, 'f', 3);
+    }
+    line += '\n';
+    m_dumpFile.write(line);
+}
+
+QT_END_NAMESPACE
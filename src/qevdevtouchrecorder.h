@@ -0,0 +1,69 @@
+#ifndef QEVDEVTOUCHRECORDER_H
+#define QEVDEVTOUCHRECORDER_H
+
+#include <linux/input.h>
+#include <qpa/qwindowsysteminterface.h>
+
+#include <QFile>
+#include <QString>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+class QEvdevTouchScreenData;
+
+// Captures the raw event stream of a touch device together with its probed properties, and plays such
+// a capture back through the decoder. Emitted touch points can be dumped as text to diff against a
+// known good run of the same capture.
+//
+// File layout (QDataStream, big endian): magic, version, protocol flags, X/Y/pressure ranges, slot
+// count, device name, then 16 bytes per event: seconds, microseconds, type, code, value.
+class QEvdevTouchRecorder
+{
+public:
+    enum Flag
+    {
+        TypeB = 0x1,
+        SingleTouch = 0x2,
+        BtnTool = 0x4,
+    };
+
+    bool startRecording(const QString &path, const QEvdevTouchScreenData *d);
+    void record(const input_event *events, int count);
+    bool isRecording() const { return m_recordFile.isOpen(); }
+
+    bool loadReplay(const QString &path);
+    void applyHeader(QEvdevTouchScreenData *d) const;
+    const std::vector<input_event> &replayEvents() const { return m_events; }
+
+    bool startPointDump(const QString &path);
+    void stopPointDump() { m_dumpFile.close(); }
+    void dumpPoints(double timeStamp, const QList<QWindowSystemInterface::TouchPoint> &points);
+    bool isDumping() const { return m_dumpFile.isOpen(); }
+
+private:
+    static const quint32 Magic = 0x4b545243;  // "KTRC"
+    static const quint32 Version = 1;
+
+    struct Header
+    {
+        quint32 flags = 0;
+        qint32 xMin = 0;
+        qint32 xMax = 0;
+        qint32 yMin = 0;
+        qint32 yMax = 0;
+        qint32 pressureMin = 0;
+        qint32 pressureMax = 0;
+        qint32 slotCount = 0;
+        QString name;
+    };
+
+    QFile m_recordFile;
+    QFile m_dumpFile;
+    Header m_header;
+    std::vector<input_event> m_events;
+};
+
+QT_END_NAMESPACE
+
+#endif  // QEVDEVTOUCHRECORDER_H
@@ -0,0 +1,17 @@
+TARGET = dithertest
+
+TEMPLATE = app
+
+# The kernels are plain C++, they are checked on their own without Qt or the plugin
+CONFIG += console
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += $$PWD/../../src
+
+SOURCES = main.cpp \
+          ../../src/dither.cpp
+
+HEADERS = ../../src/dither.h
+
+DESTDIR = build
+OBJECTS_DIR = build/obj
@@ -0,0 +1,215 @@
+// Checks the vectorized dither kernels bit for bit against dither_fallback on generated images, at the
+// Kobo resolutions and at odd widths that end lines in the middle of a vector. With --benchmark, also
+// times every kernel and prints pixels/s and cycles/pixel. Exits with 1 when a kernel doesn't match.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "dither.h"
+
+namespace
+{
+typedef void (*DitherKernel)(uint8_t *dest, uint8_t *src, int width, int height);
+
+struct Kernel
+{
+    const char *name;
+    DitherKernel kernel;
+    DitherKernel reference;  // nullptr when there is nothing to compare with
+    bool inPlace;
+};
+
+void ditherFallbackInplace(uint8_t *dest, uint8_t *, int width, int height)
+{
+    dither_fallback(dest, dest, width, height);
+}
+
+#ifdef __ARM_NEON__
+void ditherNeonInplace(uint8_t *dest, uint8_t *, int width, int height)
+{
+    dither_NEON(dest, dest, width, height);
+}
+#endif
+
+const Kernel kernels[] = {
+    {"ordered scalar", dither_fallback, nullptr, false},
+    {"ordered scalar in place", ditherFallbackInplace, dither_fallback, true},
+#ifdef __ARM_NEON__
+    {"ordered NEON", dither_NEON, dither_fallback, false},
+    {"ordered NEON in place", ditherNeonInplace, dither_fallback, true},
+#endif
+    {"Floyd-Steinberg", ditherFloydSteinberg, nullptr, false},
+    {"Floyd-Steinberg line", ditherFloydSteinbergN, ditherFloydSteinberg, false},
+};
+
+struct Size
+{
+    int width;
+    int height;
+};
+
+// The screens of the Touch/Mini, Clara HD/Libra and Forma/Sage, then widths that aren't multiples of 8
+const Size benchmarkSizes[] = {{758, 1024}, {1072, 1448}, {1404, 1872}};
+const Size checkSizes[] = {{758, 1024}, {1072, 1448}, {1404, 1872}, {1, 9},  {7, 7},
+                           {9, 5},       {13, 17},     {255, 3},     {1071, 11}, {1403, 9}};
+
+enum Pattern
+{
+    HorizontalRamp,
+    VerticalRamp,
+    Noise,
+    Flat,
+    PatternCount
+};
+
+const char *const patternNames[] = {"horizontal ramp", "vertical ramp", "noise", "flat"};
+
+std::vector<uint8_t> makeImage(Pattern pattern, int width, int height)
+{
+    std::vector<uint8_t> image(width * height);
+    uint32_t state = 0x2545f491;  // xorshift, the same noise on every run
+    for (int y = 0, p = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++, p++)
+        {
+            switch (pattern)
+            {
+                case HorizontalRamp:
+                    image[p] = uint8_t(x * 255 / std::max(width - 1, 1));
+                    break;
+                case VerticalRamp:
+                    image[p] = uint8_t(y * 255 / std::max(height - 1, 1));
+                    break;
+                case Noise:
+                    state ^= state << 13;
+                    state ^= state >> 17;
+                    state ^= state << 5;
+                    image[p] = uint8_t(state);
+                    break;
+                default:
+                    image[p] = uint8_t((y * 37) & 0xff);  // every level, a line each
+                    break;
+            }
+        }
+    }
+    return image;
+}
+
+std::vector<uint8_t> run(const Kernel &kernel, DitherKernel function, const std::vector<uint8_t> &source,
+                         int width, int height)
+{
+    // In place kernels get the source in the destination. One byte of slack catches writes past the end.
+    std::vector<uint8_t> src = source;
+    std::vector<uint8_t> dest(source.size() + 1, 0x5a);
+    if (kernel.inPlace && function == kernel.kernel)
+        std::memcpy(dest.data(), source.data(), source.size());
+    function(dest.data(), src.data(), width, height);
+    return dest;
+}
+
+bool check(const Kernel &kernel)
+{
+    bool matched = true;
+    for (const Size &size : checkSizes)
+    {
+        for (int pattern = 0; pattern < PatternCount; pattern++)
+        {
+            const std::vector<uint8_t> source = makeImage(Pattern(pattern), size.width, size.height);
+            const std::vector<uint8_t> expected = run(kernel, kernel.reference, source, size.width, size.height);
+            const std::vector<uint8_t> actual = run(kernel, kernel.kernel, source, size.width, size.height);
+
+            if (actual.back() != 0x5a)
+            {
+                printf("%s writes past the end of %dx%d\n", kernel.name, size.width, size.height);
+                matched = false;
+                continue;
+            }
+
+            int differences = 0;
+            int first = -1;
+            for (size_t p = 0; p < source.size(); p++)
+            {
+                if (actual[p] != expected[p])
+                {
+                    if (first < 0)
+                        first = int(p);
+                    differences++;
+                }
+            }
+            if (differences > 0)
+            {
+                printf("%s differs from the reference on %s %dx%d in %d pixels, first at %d,%d\n", kernel.name,
+                       patternNames[pattern], size.width, size.height, differences, first % size.width,
+                       first / size.width);
+                matched = false;
+            }
+        }
+    }
+    return matched;
+}
+
+// Estimate only: the frequency the governor reports now, not one the benchmark is pinned to
+double cpuMhz()
+{
+    FILE *file = fopen("/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq", "r");
+    if (!file)
+        return 0;
+    double khz = 0;
+    if (fscanf(file, "%lf", &khz) != 1)
+        khz = 0;
+    fclose(file);
+    return khz / 1000;
+}
+
+void benchmark(const Kernel &kernel)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const double mhz = cpuMhz();
+    for (const Size &size : benchmarkSizes)
+    {
+        const int pixels = size.width * size.height;
+        std::vector<uint8_t> source = makeImage(Noise, size.width, size.height);
+        std::vector<uint8_t> dest(pixels);
+
+        // A warm-up, then as many runs as fit in a quarter of a second
+        kernel.kernel(dest.data(), source.data(), size.width, size.height);
+        const Clock::time_point start = Clock::now();
+        Clock::duration elapsed;
+        int runs = 0;
+        do
+        {
+            kernel.kernel(dest.data(), source.data(), size.width, size.height);
+            runs++;
+            elapsed = Clock::now() - start;
+        } while (elapsed < std::chrono::milliseconds(250));
+
+        const double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+        const double nsPerPixel = ns / runs / pixels;
+        printf("%s %dx%d: %.0f pixels/s, %.2f cycles/pixel at %.0f MHz, %.2f ms/frame\n", kernel.name,
+               size.width, size.height, std::round(1e9 / nsPerPixel), nsPerPixel * mhz / 1000, mhz,
+               ns / runs / 1e6);
+    }
+}
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    const bool benchmarkKernels = argc > 1 && std::strcmp(argv[1], "--benchmark") == 0;
+
+    bool matched = true;
+    for (const Kernel &kernel : kernels)
+    {
+        if (kernel.reference && !check(kernel))
+            matched = false;
+        if (benchmarkKernels)
+            benchmark(kernel);
+    }
+
+    printf("%s\n", matched ? "All kernels match their reference" : "FAILED");
+    return matched ? 0 : 1;
+}
@@ -0,0 +1,16 @@
+// Runs the kobo plugin long enough for a touchreplay= recording to go through the touch handler, see
+// run.sh. The replay starts with the input thread and closes its touchdump= file when it is done.
+
+#include <QGuiApplication>
+#include <QTimer>
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication app(argc, argv);
+
+    // The recordings are a few dozen events, decoded in well under a millisecond
+    const int waitMs = qEnvironmentVariableIntValue("TOUCHREPLAY_WAIT_MS");
+    QTimer::singleShot(waitMs > 0 ? waitMs : 1000, &app, &QCoreApplication::quit);
+
+    return app.exec();
+}
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+# Writes the recordings replayed by ../run.sh in the touchrecord= format (QEvdevTouchRecorder). The
+# coordinates are screen pixels of the 1072x1448 virtual framebuffer, picked to normalize to quarters.
+# Regenerate with: python3 make_recordings.py
+
+import os
+import struct
+
+EV_SYN, EV_KEY, EV_ABS = 0x00, 0x01, 0x03
+SYN_REPORT, SYN_MT_REPORT = 0, 2
+BTN_TOOL_PEN, BTN_TOOL_FINGER = 0x140, 0x145
+ABS_MT_SLOT, ABS_MT_POSITION_X, ABS_MT_POSITION_Y = 0x2f, 0x35, 0x36
+ABS_MT_TOOL_TYPE, ABS_MT_TRACKING_ID = 0x37, 0x39
+MT_TOOL_FINGER, MT_TOOL_PEN = 0, 1
+
+TYPE_B, SINGLE_TOUCH, BTN_TOOL = 0x1, 0x2, 0x4
+
+
+def slot(n): return (EV_ABS, ABS_MT_SLOT, n)
+def tracking(n): return (EV_ABS, ABS_MT_TRACKING_ID, n)
+def tool(n): return (EV_ABS, ABS_MT_TOOL_TYPE, n)
+def x(n): return (EV_ABS, ABS_MT_POSITION_X, n)
+def y(n): return (EV_ABS, ABS_MT_POSITION_Y, n)
+def key(code, value): return (EV_KEY, code, value)
+def mt_report(): return (EV_SYN, SYN_MT_REPORT, 0)
+
+
+def write(name, flags, slots, device, sec, frames):
+    data = struct.pack('>IIIiiiiiii', 0x4b545243, 1, flags, 0, 1072, 0, 1448, 0, 0, slots)
+    encoded = device.encode('utf-16-be')
+    data += struct.pack('>I', len(encoded)) + encoded
+
+    # One frame every 10 ms, closed by its SYN_REPORT
+    for index, frame in enumerate(frames):
+        usec = index * 10000
+        for event in frame + [(EV_SYN, SYN_REPORT, 0)]:
+            data += struct.pack('>IIHHi', sec, usec, *event)
+
+    with open(os.path.join(os.path.dirname(os.path.abspath(__file__)), name), 'wb') as f:
+        f.write(data)
+
+
+# Protocol A: no slots, no tracking ids, the handler assigns them by distance
+write('protocol-a.rec', 0, 0, 'protocol A', 100, [
+    [x(268), y(362), mt_report()],
+    [x(536), y(362), mt_report()],
+    [x(536), y(362), mt_report(), x(804), y(724), mt_report()],
+    [x(804), y(724), mt_report()],
+    [mt_report()],
+])
+
+# Protocol B: two slots, the first one is reused by a new contact after both were lifted
+write('protocol-b.rec', TYPE_B, 2, 'protocol B', 200, [
+    [slot(0), tracking(10), x(268), y(362)],
+    [x(536)],
+    [slot(1), tracking(11), x(804), y(724)],
+    [slot(0), tracking(-1)],
+    [slot(1), x(536)],
+    [tracking(-1)],
+    [slot(0), tracking(12), x(268), y(362)],
+    [tracking(-1)],
+])
+
+# Sunxi: a pen stroke, then a finger tap. Contacts are lifted by BTN_TOOL_*, not by the tracking id
+write('sunxi-pen.rec', TYPE_B | BTN_TOOL, 2, 'sunxi pen', 300, [
+    [slot(0), tracking(20), tool(MT_TOOL_PEN), x(268), y(362), key(BTN_TOOL_PEN, 1)],
+    [x(536)],
+    [tracking(-1), key(BTN_TOOL_PEN, 0)],
+    [slot(1), tracking(21), tool(MT_TOOL_FINGER), x(804), y(724), key(BTN_TOOL_FINGER, 1)],
+    [tracking(-1), key(BTN_TOOL_FINGER, 0)],
+])
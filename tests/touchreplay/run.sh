@@ -0,0 +1,40 @@
+#!/bin/sh
+# Replays every recording in recordings/ through the touch handler of the kobo plugin on a virtual
+# framebuffer and diffs the reported touch points against expected/. Build touchreplay.pro and the
+# plugin with qmake first. After an intended decoder change, BLESS=1 ./run.sh rewrites expected/.
+#
+#   protocol-a   type A multitouch, ids assigned by the handler
+#   protocol-b   type B with two slots
+#   sunxi-pen    pen and finger on a sunxi device (Sage profile)
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+out=$(mktemp -d)
+trap 'rm -rf "$out"' EXIT
+
+export QT_QPA_PLATFORM_PLUGIN_PATH=${QT_QPA_PLATFORM_PLUGIN_PATH:-$here/../../build/ereader}
+
+failed=0
+for recording in "$here"/recordings/*.rec; do
+    name=$(basename "$recording" .rec)
+    case $name in
+        sunxi-*) codename=cadmus ;;
+        *) codename=nova ;;
+    esac
+
+    DEVICE_CODENAME=$codename \
+    QT_QPA_PLATFORM="kobo:virtualfb:size=1072x1448:touchreplay=$recording:touchdump=$out/$name.dump" \
+        "$here/build/touchreplay"
+
+    if [ -n "$BLESS" ]; then
+        cp "$out/$name.dump" "$here/expected/$name.dump"
+        echo "$name: blessed"
+    elif diff -u "$here/expected/$name.dump" "$out/$name.dump"; then
+        echo "$name: ok"
+    else
+        echo "$name: FAILED"
+        failed=1
+    fi
+done
+
+exit $failed
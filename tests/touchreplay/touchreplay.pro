@@ -0,0 +1,18 @@
+TARGET = touchreplay
+
+TEMPLATE = app
+
+DEFINES += QT_NO_FOREACH
+
+QT += gui
+
+# The plugin is loaded through QT_QPA_PLATFORM, nothing of it is linked in
+SOURCES = main.cpp
+
+OTHER_FILES += \
+    run.sh \
+    recordings/make_recordings.py
+
+DESTDIR = build
+OBJECTS_DIR = build/obj
+MOC_DIR = build/moc